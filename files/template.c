@@ -6,18 +6,29 @@ typedef struct {
     const char *name;
 } Proc;
 
-static Proc lookup[] = {
 %COMMAND_LOOKUP%
+
+static const struct {
+    Proc *procs;
+    size_t count;
+} clad_lookups[] = {
+%LOOKUP_TABLES%
 };
 
 int clad_init_gl(CladProcAddrLoader load_proc) {
-    for (size_t i = 0; i < sizeof(lookup) / sizeof(*lookup); i++) {
-        lookup[i].proc = load_proc(lookup[i].name);
-        if (lookup[i].proc == NULL) {
-            return 0;
+    size_t count = sizeof(clad_lookups) / sizeof(*clad_lookups);
+    for (size_t i = 0; i < count; i++) {
+        Proc *procs = clad_lookups[i].procs;
+        for (size_t j = 0; j < clad_lookups[i].count; j++) {
+            procs[j].proc = load_proc(procs[j].name);
+            if (procs[j].proc == NULL) {
+                return 0;
+            }
         }
     }
     return 1;
 }
 
+%COMMAND_TYPES%
+
 %COMMAND_WRAPPERS%
@@ -0,0 +1,12 @@
+#include <clad/gl.h>
+
+typedef struct {
+    CladProc proc;
+    const char *name;
+} Proc;
+
+extern Proc clad_lookup_%SHARD%[];
+
+%COMMAND_TYPES%
+
+%COMMAND_WRAPPERS%
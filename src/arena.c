@@ -0,0 +1,91 @@
+#include "arena.h"
+#include "mem.h"
+
+#define ARENA_BLOCK_SIZE (256 * 1024)
+#define ARENA_ALIGNMENT 16
+
+struct _ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    // Padding so that `data` is aligned to `ARENA_ALIGNMENT`.
+    size_t _pad;
+    unsigned char data[];
+};
+
+static ArenaBlock *new_block(size_t capacity) {
+    ArenaBlock *block = mem_malloc(sizeof(*block) + capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *head = arena->head;
+    if (head == NULL || head->capacity - head->used < size) {
+        // Oversized allocations get a block of their own.
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        ArenaBlock *block = new_block(capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+
+        // Keep filling the current block if the new one is a one-off.
+        if (head != NULL && capacity != ARENA_BLOCK_SIZE) {
+            block->next = head->next;
+            head->next = block;
+        } else {
+            block->next = head;
+            arena->head = block;
+        }
+
+        arena->block_count++;
+        head = block;
+    }
+
+    void *ptr = &head->data[head->used];
+    head->used += size;
+    arena->bytes_used += size;
+    return ptr;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        mem_free(block);
+        block = next;
+    }
+
+    *arena = (Arena){ 0 };
+}
+
+void arena_absorb(Arena *dst, Arena *src) {
+    if (src->head == NULL) {
+        return;
+    }
+
+    // Append behind the current head so that `dst` keeps filling it.
+    ArenaBlock *tail = src->head;
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+
+    if (dst->head == NULL) {
+        dst->head = src->head;
+    } else {
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    }
+
+    dst->block_count += src->block_count;
+    dst->bytes_used += src->bytes_used;
+    *src = (Arena){ 0 };
+}
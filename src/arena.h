@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct _ArenaBlock ArenaBlock;
+
+// A bump allocator. Every allocation made through an arena lives until the
+// whole arena is released with `arena_free`.
+typedef struct {
+    ArenaBlock *head;
+    size_t block_count;
+    size_t bytes_used;
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+void arena_free(Arena *arena);
+
+// Moves every block of `src` into `dst`, leaving `src` empty.
+void arena_absorb(Arena *dst, Arena *src);
+
+#endif
@@ -0,0 +1,335 @@
+// Benchmarks the whole generator, in process, for every combination of profile
+// and version it knows, for the `gl` API unless --api picks another. Each
+// configuration is generated a number of times and the median of every phase
+// is printed as one JSON object per line, so results can be collected and
+// compared across commits, and a phase that grows faster than the
+// configurations do stands out.
+
+#include "generator.h"
+#include "mem.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CLAD_GL_XML
+#define CLAD_GL_XML "files/gl.xml"
+#endif
+
+#ifndef CLAD_TEMPLATE_H
+#define CLAD_TEMPLATE_H "files/template.h"
+#endif
+
+#ifndef CLAD_TEMPLATE_C
+#define CLAD_TEMPLATE_C "files/template.c"
+#endif
+
+// Where the outputs go unless --out-dir says otherwise. Without a build
+// directory to default to, --out-dir is required.
+#ifndef CLAD_GEN_BENCH_DIR
+#define CLAD_GEN_BENCH_DIR NULL
+#endif
+
+#define MAX_GENERATOR_ARGS 32
+
+static const char *const api_names[] = { "gl", "gles1", "gles2", "glsc2" };
+static const char *const profile_names[] = { "core", "compatibility" };
+
+static const char *const phase_names[] = {
+#define X(phase, name) #name,
+    STATS_PHASES
+#undef X
+};
+
+static const char *const version_names[] = {
+#define X(version, short) #short,
+    GL_VERSIONS
+#undef X
+};
+
+typedef struct {
+    const char *xml_path;
+    const char *header_template;
+    const char *source_template;
+    const char *out_dir;
+    const char *label;
+    size_t iterations;
+    size_t jobs;
+    bool cache;
+    bool snake_case;
+    // Only configurations matching these run, if set. `api` is "gl" unless
+    // --api says otherwise.
+    const char *api;
+    const char *profile;
+    const char *version;
+} BenchOptions;
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static double median(double *values, size_t count) {
+    qsort(values, count, sizeof(*values), compare_doubles);
+    return count % 2 ? values[count / 2]
+                     : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Labels are written as JSON strings, so quotes and backslashes are escaped.
+static void print_json_string(const char *str) {
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            putchar('\\');
+        }
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t size = strlen(dir) + strlen(name) + 2;
+    char *path = mem_malloc(size);
+    snprintf(path, size, "%s/%s", dir, name);
+    return path;
+}
+
+// A command line for the generator, kept NULL-terminated as it grows.
+typedef struct {
+    const char *args[MAX_GENERATOR_ARGS + 1];
+    size_t count;
+    bool overflowed;
+} GeneratorArgs;
+
+static void push_arg(GeneratorArgs *argv, const char *arg) {
+    if (argv->count >= MAX_GENERATOR_ARGS) {
+        argv->overflowed = true;
+        return;
+    }
+    argv->args[argv->count++] = arg;
+}
+
+// Options are built through the generator's own command line parser, so each
+// run sees exactly what `clad_generator` would for the same flags.
+static bool run_config(const BenchOptions *options, Target target,
+                       const char *cache_path) {
+    char jobs[32];
+    snprintf(jobs, sizeof(jobs), "%zu", options->jobs);
+
+    GeneratorArgs argv = { 0 };
+    push_arg(&argv, "clad_gen_bench");
+    push_arg(&argv, "--in-xml");
+    push_arg(&argv, options->xml_path);
+    push_arg(&argv, "--out-header");
+    push_arg(&argv, target.output_header);
+    push_arg(&argv, "--out-source");
+    push_arg(&argv, target.output_source);
+    push_arg(&argv, "--header-template");
+    push_arg(&argv, options->header_template);
+    push_arg(&argv, "--source-template");
+    push_arg(&argv, options->source_template);
+    push_arg(&argv, "--api");
+    push_arg(&argv, api_names[target.api]);
+    push_arg(&argv, "--profile");
+    push_arg(&argv, profile_names[target.profile]);
+    push_arg(&argv, "--version");
+    push_arg(&argv, version_names[target.version]);
+    push_arg(&argv, "--jobs");
+    push_arg(&argv, jobs);
+    if (cache_path) {
+        push_arg(&argv, "--registry-cache");
+        push_arg(&argv, cache_path);
+    }
+    if (target.use_snake_case) {
+        push_arg(&argv, "--snake-case");
+    }
+    if (argv.overflowed) {
+        fprintf(stderr, "error: more than %d generator arguments\n",
+                MAX_GENERATOR_ARGS);
+        return false;
+    }
+
+    CladOptions opts = generator_parse_arguments((char **)argv.args);
+    if (!opts.parsed_succesfully) {
+        generator_free_options(opts);
+        return false;
+    }
+
+    size_t iterations = options->iterations;
+    double *times = mem_calloc((STATS_PHASE_COUNT + 1) * iterations,
+                               sizeof(*times));
+    double *totals = &times[STATS_PHASE_COUNT * iterations];
+    Stats first = { 0 };
+    Stats before = { 0 };
+    Stats after = { 0 };
+
+    for (size_t i = 0; i < iterations; i++) {
+        Stats stats = { 0 };
+        stats_finish(&before);
+        double start = stats_now();
+        if (!generator_run(opts, NULL, &stats)) {
+            generator_free_options(opts);
+            mem_free(times);
+            return false;
+        }
+        totals[i] = stats_now() - start;
+        stats_finish(&after);
+
+        for (size_t phase = 0; phase < STATS_PHASE_COUNT; phase++) {
+            times[phase * iterations + i] = stats.seconds[phase];
+        }
+        if (i == 0) {
+            first = stats;
+            first.allocations = after.allocations - before.allocations;
+            first.allocated_bytes =
+                after.allocated_bytes - before.allocated_bytes;
+        }
+    }
+
+    printf("{\"bench\":\"clad_gen\",\"label\":");
+    print_json_string(options->label);
+    printf(",\"api\":\"%s\",\"profile\":\"%s\",\"version\":\"%s\","
+           "\"snake_case\":%s,\"cache\":%s,\"jobs\":%zu,\"iterations\":%zu,"
+           "\"requirements\":%zu,\"commands\":%zu,\"enums\":%zu,"
+           "\"allocations\":%llu,\"allocated_bytes\":%llu,"
+           "\"total_ms_median\":%.3f",
+           api_names[target.api], profile_names[target.profile],
+           version_names[target.version],
+           options->snake_case ? "true" : "false",
+           cache_path ? "true" : "false", options->jobs, iterations,
+           first.requirements, first.commands, first.enums,
+           (unsigned long long)first.allocations,
+           (unsigned long long)first.allocated_bytes,
+           median(totals, iterations) * 1e3);
+    for (size_t phase = 0; phase < STATS_PHASE_COUNT; phase++) {
+        printf(",\"%s_ms_median\":%.3f", phase_names[phase],
+               median(&times[phase * iterations], iterations) * 1e3);
+    }
+    printf("}\n");
+    fflush(stdout);
+
+    generator_free_options(opts);
+    mem_free(times);
+    return true;
+}
+
+static bool matches(const char *filter, const char *name) {
+    return filter == NULL || strcmp(filter, name) == 0;
+}
+
+static void print_usage(void) {
+    fprintf(stderr,
+            "Usage: clad_gen_bench [--xml <path>] [--header-template <path>]\n"
+            "                      [--source-template <path>] "
+            "[--out-dir <path>]\n"
+            "                      [--iterations <n>] [--jobs <n>] [--cache]\n"
+            "                      [--snake-case] [--label <text>]\n"
+            "                      [--api <api>] [--profile <profile>]\n"
+            "                      [--version <version>]\n"
+            "\n"
+            "Every configuration is written to clad_gen_bench_out.h and\n"
+            "clad_gen_bench_out.c in the output directory, which defaults to\n"
+            "one in the build directory. With --cache, the registry is loaded\n"
+            "from a cache there, as a build would after the first run.\n"
+            "\n"
+            "Only the gl API runs by default. Versions name GL_VERSION_*\n"
+            "features, which gles1, gles2 and glsc2 don't have, so they\n"
+            "generate no commands at any version.\n");
+}
+
+static bool parse_bench_options(char **argv, BenchOptions *options) {
+    for (char **arg = argv + 1; *arg != NULL; arg++) {
+        bool has_value = arg[1] != NULL;
+        if (strcmp(*arg, "--cache") == 0) {
+            options->cache = true;
+        } else if (strcmp(*arg, "--snake-case") == 0) {
+            options->snake_case = true;
+        } else if (strcmp(*arg, "--xml") == 0 && has_value) {
+            options->xml_path = *++arg;
+        } else if (strcmp(*arg, "--header-template") == 0 && has_value) {
+            options->header_template = *++arg;
+        } else if (strcmp(*arg, "--source-template") == 0 && has_value) {
+            options->source_template = *++arg;
+        } else if (strcmp(*arg, "--out-dir") == 0 && has_value) {
+            options->out_dir = *++arg;
+        } else if (strcmp(*arg, "--label") == 0 && has_value) {
+            options->label = *++arg;
+        } else if (strcmp(*arg, "--iterations") == 0 && has_value) {
+            options->iterations = strtoul(*++arg, NULL, 10);
+        } else if (strcmp(*arg, "--jobs") == 0 && has_value) {
+            options->jobs = strtoul(*++arg, NULL, 10);
+        } else if (strcmp(*arg, "--api") == 0 && has_value) {
+            options->api = *++arg;
+        } else if (strcmp(*arg, "--profile") == 0 && has_value) {
+            options->profile = *++arg;
+        } else if (strcmp(*arg, "--version") == 0 && has_value) {
+            options->version = *++arg;
+        } else {
+            return false;
+        }
+    }
+
+    return options->iterations > 0 && options->jobs > 0 &&
+           options->out_dir != NULL;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+
+    BenchOptions options = {
+        .xml_path = CLAD_GL_XML,
+        .header_template = CLAD_TEMPLATE_H,
+        .source_template = CLAD_TEMPLATE_C,
+        .out_dir = CLAD_GEN_BENCH_DIR,
+        .label = "",
+        .iterations = 7,
+        .jobs = 1,
+        .api = "gl",
+    };
+    if (!parse_bench_options(argv, &options)) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    stats_count_allocations();
+
+    char *header_path = join_path(options.out_dir, "clad_gen_bench_out.h");
+    char *source_path = join_path(options.out_dir, "clad_gen_bench_out.c");
+    char *cache_path =
+        options.cache
+            ? join_path(options.out_dir, "clad_gen_bench_out.xml.cache")
+            : NULL;
+
+    bool success = true;
+    size_t api_count = sizeof(api_names) / sizeof(*api_names);
+    size_t profile_count = sizeof(profile_names) / sizeof(*profile_names);
+    for (size_t api = 0; success && api < api_count; api++) {
+        for (size_t profile = 0; success && profile < profile_count;
+             profile++) {
+            for (size_t version = 0; success && version < GL_VERSION_INVALID;
+                 version++) {
+                if (!matches(options.api, api_names[api]) ||
+                    !matches(options.profile, profile_names[profile]) ||
+                    !matches(options.version, version_names[version])) {
+                    continue;
+                }
+
+                Target target = {
+                    .output_header = header_path,
+                    .output_source = source_path,
+                    .api = (GLAPIType)api,
+                    .profile = (GLProfile)profile,
+                    .version = (GLVersion)version,
+                    .use_snake_case = options.snake_case,
+                };
+                success = run_config(&options, target, cache_path);
+            }
+        }
+    }
+
+    mem_free(header_path);
+    mem_free(source_path);
+    mem_free(cache_path);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,2278 @@
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "generator.h"
+#include "mem.h"
+#include "registry.h"
+#include "stats.h"
+#include "string_buffer.h"
+#include "string_view.h"
+#include "template.h"
+#include "thread.h"
+#include "usage.h"
+#include "xml.h"
+#include "xml_compact.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Part of the key that decides whether the outputs are up to date. Bump it
+// whenever the generator's output changes for the same inputs.
+#define CLAD_GENERATOR_VERSION "clad 1"
+
+static GLVersion gl_version_from_sv(StringView sv) {
+#define X(version, short)                                                      \
+    if (sv_equal_cstr(sv, #version))                                           \
+        return version;
+    GL_VERSIONS
+#undef X
+    return GL_VERSION_INVALID;
+}
+
+static GLVersion gl_version_from_sv_short(StringView sv) {
+#define X(version, short)                                                      \
+    if (sv_equal_cstr(sv, #short))                                             \
+        return version;
+    GL_VERSIONS
+#undef X
+    return GL_VERSION_INVALID;
+}
+
+static GLAPIType gl_api_from_sv(StringView sv) {
+    if (sv_equal_cstr(sv, "gl"))
+        return GL_API_GL;
+    if (sv_equal_cstr(sv, "gles1"))
+        return GL_API_GLES1;
+    if (sv_equal_cstr(sv, "gles2"))
+        return GL_API_GLES2;
+    if (sv_equal_cstr(sv, "glsc2"))
+        return GL_API_GLSC2;
+    return GL_API_INVALID;
+}
+
+static GLProfile gl_profile_from_sv(StringView sv) {
+    if (sv_equal_cstr(sv, "core"))
+        return GL_PROFILE_CORE;
+    if (sv_equal_cstr(sv, "compatibility"))
+        return GL_PROFILE_COMPATIBILITY;
+    return GL_PROFILE_INVALID;
+}
+
+typedef struct {
+    const char *input_xml;
+    const char *output_header;
+    const char *output_source;
+    const char *api;
+    const char *profile;
+    const char *version;
+    const char *header_template;
+    const char *source_template;
+    const char *registry_cache;
+    const char *output_registry;
+    const char *jobs;
+    const char *stamp;
+    const char *manifest;
+    const char *usage;
+    const char *shards;
+    const char *shard_template;
+    const char *stats_json;
+    bool use_snake_case;
+    bool stats;
+} RawArguments;
+
+// The definitions required by the selected features, in the order they were
+// first mentioned. A <remove> only clears `required`, so a definition keeps its
+// place if a later feature requires it again.
+typedef struct {
+    DefinitionType *types;
+    StringView *names;
+    bool *required;
+    size_t length;
+    size_t capacity;
+
+    // A hash set over (type, name). Each slot holds an index into the arrays
+    // above plus one, so 0 marks an empty slot.
+    uint32_t *slots;
+    size_t slot_count;
+} RequirementList;
+
+static RequirementList rl_init(void) {
+    RequirementList rl = { 0 };
+    rl.capacity = 32;
+    rl.types = mem_calloc(rl.capacity, sizeof(*rl.types));
+    rl.names = mem_calloc(rl.capacity, sizeof(*rl.names));
+    rl.required = mem_calloc(rl.capacity, sizeof(*rl.required));
+    rl.slot_count = 2 * rl.capacity;
+    rl.slots = mem_calloc(rl.slot_count, sizeof(*rl.slots));
+    return rl;
+}
+
+// Returns the slot that holds the definition, or the empty slot where it
+// belongs.
+static size_t rl_find_slot(const RequirementList *rl, DefinitionType type,
+                           StringView name) {
+    size_t mask = rl->slot_count - 1;
+    size_t slot = (sv_hash(name) ^ (uint32_t)type * 0x9e3779b9u) & mask;
+
+    while (rl->slots[slot] != 0) {
+        size_t i = rl->slots[slot] - 1;
+        if (rl->types[i] == type && sv_equal(rl->names[i], name)) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void rl_add(RequirementList *rl, DefinitionType type, StringView name,
+                   bool required) {
+    // First check whether the feature is in the list.
+    size_t slot = rl_find_slot(rl, type, name);
+    if (rl->slots[slot] != 0) {
+        rl->required[rl->slots[slot] - 1] = required;
+        return;
+    }
+
+    if (rl->length >= rl->capacity) {
+        rl->capacity *= 2;
+        rl->types = mem_realloc(rl->types, rl->capacity * sizeof(*rl->types));
+        rl->names = mem_realloc(rl->names, rl->capacity * sizeof(*rl->names));
+        rl->required =
+            mem_realloc(rl->required, rl->capacity * sizeof(*rl->required));
+    }
+
+    rl->types[rl->length] = type;
+    rl->names[rl->length] = name;
+    rl->required[rl->length] = required;
+    rl->length++;
+    rl->slots[slot] = (uint32_t)rl->length;
+
+    // Keep the set at most half full.
+    if (2 * rl->length >= rl->slot_count) {
+        mem_free(rl->slots);
+        rl->slot_count *= 2;
+        rl->slots = mem_calloc(rl->slot_count, sizeof(*rl->slots));
+        for (size_t i = 0; i < rl->length; i++) {
+            slot = rl_find_slot(rl, rl->types[i], rl->names[i]);
+            rl->slots[slot] = (uint32_t)i + 1;
+        }
+    }
+}
+
+static void rl_free(RequirementList rl) {
+    mem_free(rl.types);
+    mem_free(rl.names);
+    mem_free(rl.required);
+    mem_free(rl.slots);
+}
+
+// The elements of the registry that generation actually read, and how much of
+// each has to be kept to generate the same output from a pruned registry.
+typedef struct {
+    const xml_Token *element;
+    xml_WriteMode mode;
+} KeptElement;
+
+typedef struct {
+    KeptElement *elements;
+    size_t length;
+    size_t capacity;
+} KeptElements;
+
+#define HEADER_VARIABLES                                                       \
+    X(HEADER_TYPES, TYPES)                                                     \
+    X(HEADER_ENUMS, ENUMS)                                                     \
+    X(HEADER_COMMAND_DECLARATIONS, COMMAND_DECLARATIONS)
+
+#define SOURCE_VARIABLES                                                       \
+    X(SOURCE_COMMAND_LOOKUP, COMMAND_LOOKUP)                                   \
+    X(SOURCE_LOOKUP_TABLES, LOOKUP_TABLES)                                     \
+    X(SOURCE_COMMAND_TYPES, COMMAND_TYPES)                                     \
+    X(SOURCE_COMMAND_WRAPPERS, COMMAND_WRAPPERS)
+
+#define SHARD_VARIABLES                                                        \
+    X(SHARD_INDEX, SHARD)                                                      \
+    X(SHARD_COMMAND_TYPES, COMMAND_TYPES)                                      \
+    X(SHARD_COMMAND_WRAPPERS, COMMAND_WRAPPERS)
+
+#define X(slot, name) slot,
+enum { HEADER_VARIABLES HEADER_VARIABLE_COUNT };
+enum { SOURCE_VARIABLES SOURCE_VARIABLE_COUNT };
+enum { SHARD_VARIABLES SHARD_VARIABLE_COUNT };
+#undef X
+
+#define X(slot, name) #name,
+static const char *const header_variables[] = { HEADER_VARIABLES };
+static const char *const source_variables[] = { SOURCE_VARIABLES };
+static const char *const shard_variables[] = { SHARD_VARIABLES };
+#undef X
+
+// The templates, compiled once and built for every target.
+typedef struct {
+    Template header;
+    Template source;
+    // Only loaded when there are shards.
+    Template shard;
+} Templates;
+
+static bool load_template(const char *path, const char *const *names,
+                          size_t name_count, Template *template) {
+    char *source = xml_read_file(path);
+    if (source == NULL) {
+        return false;
+    }
+    template_compile(source, names, name_count, template);
+    return true;
+}
+
+static bool load_templates(CladOptions opts, Templates *templates) {
+    *templates = (Templates){ 0 };
+
+    bool success =
+        load_template(opts.header_template_path, header_variables,
+                      HEADER_VARIABLE_COUNT, &templates->header) &&
+        load_template(opts.source_template_path, source_variables,
+                      SOURCE_VARIABLE_COUNT, &templates->source);
+    if (success && opts.shards > 0) {
+        success = load_template(opts.shard_template_path, shard_variables,
+                                SHARD_VARIABLE_COUNT, &templates->shard);
+    }
+
+    if (!success) {
+        template_free(&templates->header);
+        template_free(&templates->source);
+    }
+    return success;
+}
+
+static void free_templates(Templates *templates) {
+    template_free(&templates->header);
+    template_free(&templates->source);
+    template_free(&templates->shard);
+}
+
+typedef struct {
+    bool use_snake_case;
+
+    GLAPIType api;
+    GLProfile profile;
+    GLVersion version;
+    const Registry *registry;
+    // Only the definitions named here are generated, if set.
+    const Usage *usage;
+    RequirementList requirements;
+
+    // The required commands, in the order they are generated.
+    size_t jobs;
+    const Command **commands;
+    size_t command_count;
+    size_t commands_capacity;
+
+    StringBuffer types;
+    StringBuffer enums;
+    StringBuffer command_lookup;
+    StringBuffer command_wrappers;
+    StringBuffer command_decls;
+    StringBuffer command_types;
+    StringBuffer scratch;
+
+    // The typedef each required command is called through, pointing into
+    // `type_names`.
+    StringView *command_type_names;
+    StringBuffer type_names;
+    // Which typedef each command uses, and where each typedef's declaration
+    // starts in `command_types`, so a shard can declare only the ones it uses.
+    size_t *command_type_ids;
+    size_t *type_decl_offsets;
+    size_t type_count;
+    // Where each command's wrapper ends in `command_wrappers`.
+    size_t *wrapper_ends;
+
+    size_t shards;
+    // With shards, the shard each command's wrapper goes to, and the command's
+    // index in that shard's lookup table.
+    size_t *command_shards;
+    size_t *shard_indices;
+
+    // Only recorded when a pruned registry is written.
+    bool record_kept;
+    KeptElements kept;
+
+    const Templates *templates;
+    const char *output_header;
+    const char *output_source;
+
+    Stats stats;
+} GenerationContext;
+
+static GenerationContext init_context(CladOptions opts, Target target) {
+    GenerationContext ctx = { 0 };
+    ctx.use_snake_case = target.use_snake_case;
+    ctx.api = target.api;
+    ctx.profile = target.profile;
+    ctx.version = target.version;
+    ctx.shards = opts.shards;
+    ctx.requirements = rl_init();
+    ctx.types = sb_new_buffer();
+    ctx.enums = sb_new_buffer();
+    ctx.command_lookup = sb_new_buffer();
+    ctx.command_wrappers = sb_new_buffer();
+    ctx.command_decls = sb_new_buffer();
+    ctx.command_types = sb_new_buffer();
+    ctx.type_names = sb_new_buffer();
+    ctx.scratch = sb_new_buffer();
+    ctx.record_kept = opts.output_registry != NULL;
+    ctx.output_header = target.output_header;
+    ctx.output_source = target.output_source;
+    return ctx;
+}
+
+static void free_context(GenerationContext ctx) {
+    sb_free(ctx.types);
+    sb_free(ctx.enums);
+    sb_free(ctx.command_lookup);
+    sb_free(ctx.command_wrappers);
+    sb_free(ctx.command_decls);
+    sb_free(ctx.command_types);
+    sb_free(ctx.type_names);
+    mem_free(ctx.command_type_names);
+    mem_free(ctx.command_type_ids);
+    mem_free(ctx.type_decl_offsets);
+    mem_free(ctx.wrapper_ends);
+    mem_free(ctx.command_shards);
+    mem_free(ctx.shard_indices);
+    sb_free(ctx.scratch);
+    rl_free(ctx.requirements);
+    mem_free(ctx.commands);
+    mem_free(ctx.kept.elements);
+}
+
+static void keep_element(GenerationContext *ctx, const xml_Token *element,
+                         xml_WriteMode mode) {
+    if (!ctx->record_kept) {
+        return;
+    }
+
+    KeptElements *kept = &ctx->kept;
+    if (kept->length >= kept->capacity) {
+        kept->capacity = kept->capacity == 0 ? 64 : kept->capacity * 2;
+        kept->elements = mem_realloc(kept->elements,
+                                     kept->capacity * sizeof(*kept->elements));
+    }
+
+    kept->elements[kept->length++] = (KeptElement){
+        .element = element,
+        .mode = mode,
+    };
+}
+
+static void generate_types(GenerationContext *ctx) {
+    const Registry *registry = ctx->registry;
+    keep_element(ctx, registry->types_element, XML_WRITE_ALL);
+
+    size_t length = 0;
+    for (size_t i = 0; i < registry->type_count; i++) {
+        length += registry->types[i].text.length + 1;
+    }
+    sb_reserve(&ctx->types, length);
+
+    for (size_t i = 0; i < registry->type_count; i++) {
+        StringView text = registry->types[i].text;
+        sb_putsn(&ctx->types, text.start, text.length);
+        sb_putc('\n', &ctx->types);
+    }
+}
+
+static void write_snake_case(StringBuffer *sb, StringView name) {
+    char previous = '\0';
+    for (size_t i = 0; i < name.length; i++) {
+        char ch = name.start[i];
+
+        if (isupper(ch) && islower(previous)) {
+            sb_putc('_', sb);
+            sb_putc(ch + 32, sb); // TODO: magic number
+        } else {
+            sb_putc(ch, sb);
+        }
+
+        previous = ch;
+    }
+}
+
+static void write_prototype(StringBuffer *sb, const Registry *registry,
+                            const Command *command, bool snake_case) {
+    // Write return type
+    sb_put_sv(sb, command->return_type);
+
+    // Write function name
+    if (snake_case) {
+        write_snake_case(sb, command->name);
+    } else {
+        sb_put_sv(sb, command->name);
+    }
+
+    // Function parameters
+    sb_putc('(', sb);
+
+    const Param *params = &registry->params[command->first_param];
+    for (size_t i = 0; i < command->param_count; i++) {
+        if (i > 0) {
+            sb_puts(", ", sb);
+        }
+        sb_put_sv(sb, params[i].declaration);
+    }
+
+    // Function doesn't have any parameters
+    if (command->param_count == 0) {
+        sb_puts("void", sb);
+    }
+
+    sb_puts(")", sb);
+}
+
+// Writes the command's function pointer type, declaring `name` if it isn't
+// empty.
+static void write_as_function_ptr_type(StringBuffer *sb,
+                                       const Registry *registry,
+                                       const Command *command,
+                                       StringView name) {
+    // Write return type.
+    sb_put_sv(sb, command->return_type);
+
+    sb_puts("(*", sb);
+    sb_put_sv(sb, name);
+    sb_putc(')', sb);
+    sb_putc('(', sb);
+
+    // Only write the types, not paramater names.
+    const Param *params = &registry->params[command->first_param];
+    for (size_t i = 0; i < command->param_count; i++) {
+        if (i > 0) {
+            sb_puts(", ", sb);
+        }
+        sb_put_sv(sb, params[i].type);
+    }
+
+    // Function doesn't have any parameters
+    if (command->param_count == 0) {
+        sb_puts("void", sb);
+    }
+
+    sb_putc(')', sb);
+}
+
+static void write_parameter_names(StringBuffer *sb, const Registry *registry,
+                                  const Command *command) {
+    const Param *params = &registry->params[command->first_param];
+    for (size_t i = 0; i < command->param_count; i++) {
+        if (i > 0) {
+            sb_puts(", ", sb);
+        }
+        sb_put_sv(sb, params[i].name);
+    }
+}
+
+// The wrapper calls through entry `index` of the lookup table `table`.
+static void write_body(StringBuffer *sb, const Registry *registry,
+                       const Command *command, StringView type_name,
+                       const char *table, size_t index) {
+    // Function body
+    sb_puts("{\n    ", sb);
+
+    // If the command doesn't return anything, the wrapper also shouldn't return
+    // anything. This avoids a warning.
+    if (!command->returns_void) {
+        sb_puts("return ", sb);
+    }
+
+    sb_putc('(', sb);
+
+    // Cast to appropriate function pointer.
+    sb_putc('(', sb);
+    sb_put_sv(sb, type_name);
+    sb_putc(')', sb);
+
+    // Lookup function pointer.
+    sb_printf(sb, "%s[%zu].proc", table, index);
+
+    sb_putc(')', sb);
+
+    // Finally provide the argumets.
+    sb_putc('(', sb);
+    write_parameter_names(sb, registry, command);
+    sb_puts(");\n", sb);
+
+    sb_puts("}\n\n", sb);
+}
+
+// A run of required commands whose wrappers, declarations and lookup entries
+// are generated into buffers of their own, possibly on another thread.
+typedef struct {
+    const Registry *registry;
+    bool use_snake_case;
+    const Command **commands;
+    // The function pointer type of each command.
+    const StringView *type_names;
+    size_t count;
+    // The lookup index of the first command.
+    size_t command_index;
+    // Set with shards, as in GenerationContext.
+    const size_t *command_shards;
+    const size_t *shard_indices;
+
+    StringBuffer command_lookup;
+    StringBuffer command_wrappers;
+    StringBuffer command_decls;
+    // Where each command's wrapper ends in `command_wrappers`.
+    size_t *wrapper_ends;
+} CommandJob;
+
+static void put_lookup_entry(StringBuffer *sb, const Command *command) {
+    sb_puts("    { NULL, \"", sb);
+    sb_put_sv(sb, command->name);
+    sb_puts("\" },\n", sb);
+}
+
+// Generates the wrapper and lookup entry of the job's `i`th command. With
+// shards, a wrapper calls through its own shard's lookup table.
+static void generate_command_wrapper(CommandJob *job, size_t i) {
+    const Command *command = job->commands[i];
+    char table[32] = "clad_lookup";
+    size_t index = job->command_index + i;
+    if (job->command_shards) {
+        snprintf(table, sizeof(table), "clad_lookup_%zu",
+                 job->command_shards[i]);
+        index = job->shard_indices[i];
+    }
+
+    write_prototype(&job->command_wrappers, job->registry, command,
+                    job->use_snake_case);
+    write_body(&job->command_wrappers, job->registry, command,
+               job->type_names[i], table, index);
+    put_lookup_entry(&job->command_lookup, command);
+}
+
+static void generate_command_declaration(CommandJob *job,
+                                         const Command *command) {
+    write_prototype(&job->command_decls, job->registry, command,
+                    job->use_snake_case);
+    sb_puts(";\n", &job->command_decls);
+}
+
+// An upper bound on the length of the command's prototype, allowing for every
+// character of the name to gain an underscore in snake case.
+static size_t prototype_length(const Registry *registry,
+                               const Command *command) {
+    size_t length = command->return_type.length + 2 * command->name.length;
+    const Param *params = &registry->params[command->first_param];
+    for (size_t i = 0; i < command->param_count; i++) {
+        length += params[i].declaration.length + 2;
+    }
+    return length + sizeof("(void)");
+}
+
+// Presizes the job's buffers so that they are filled without reallocating.
+static void reserve_command_job(CommandJob *job) {
+    size_t lookup = 0;
+    size_t wrappers = 0;
+    size_t decls = 0;
+    for (size_t i = 0; i < job->count; i++) {
+        const Command *command = job->commands[i];
+        size_t prototype = prototype_length(job->registry, command);
+
+        lookup += command->name.length + sizeof("    { NULL, \"\" },\n");
+        // The body casts through the typedef, spells out the lookup table's
+        // shard, if any, and index, which have at most 20 digits each, and
+        // passes on the parameters.
+        wrappers += prototype + job->type_names[i].length + 41 +
+                    sizeof("{\n    return (()clad_lookup[].proc)();\n}\n\n");
+        const Param *params = &job->registry->params[command->first_param];
+        for (size_t j = 0; j < command->param_count; j++) {
+            wrappers += params[j].name.length + 2;
+        }
+        decls += prototype + sizeof(";\n");
+    }
+
+    sb_reserve(&job->command_lookup, lookup);
+    sb_reserve(&job->command_wrappers, wrappers);
+    sb_reserve(&job->command_decls, decls);
+}
+
+static void run_command_job(void *arg) {
+    CommandJob *job = arg;
+    reserve_command_job(job);
+    for (size_t i = 0; i < job->count; i++) {
+        generate_command_wrapper(job, i);
+        job->wrapper_ends[i] = job->command_wrappers.length;
+        generate_command_declaration(job, job->commands[i]);
+    }
+}
+
+static void append_buffer(StringBuffer *dst, StringBuffer src) {
+    sb_putsn(dst, src.ptr, src.length);
+    sb_free(src);
+}
+
+// The distinct signatures of the required commands, written as
+// "ret(*)(types)" back to back in `text`, with a hash set over them.
+typedef struct {
+    StringBuffer text;
+    size_t *offsets;
+    size_t *lengths;
+    // The hash each signature's typedef is named after.
+    uint32_t *hashes;
+    size_t count;
+    size_t capacity;
+
+    // Each slot holds a signature index plus one, so 0 marks an empty slot.
+    // `slots` is keyed by signature and `name_slots` by hash.
+    uint32_t *slots;
+    uint32_t *name_slots;
+    size_t slot_count;
+} SignatureSet;
+
+static StringView signature_at(const SignatureSet *set, size_t index) {
+    return (StringView){
+        .start = &set->text.ptr[set->offsets[index]],
+        .length = set->lengths[index],
+    };
+}
+
+// Returns the slot that holds `signature`, or the empty slot where it belongs.
+static size_t find_signature_slot(const SignatureSet *set,
+                                  StringView signature) {
+    size_t mask = set->slot_count - 1;
+    size_t slot = sv_hash(signature) & mask;
+
+    while (set->slots[slot] != 0 &&
+           !sv_equal(signature_at(set, set->slots[slot] - 1), signature)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Returns the earliest signature with `hash`. If there is none, the one being
+// added is recorded under it and its own index is returned.
+static size_t first_with_hash(SignatureSet *set, uint32_t hash) {
+    size_t mask = set->slot_count - 1;
+    size_t slot = hash & mask;
+
+    while (set->name_slots[slot] != 0) {
+        if (set->hashes[set->name_slots[slot] - 1] == hash) {
+            return set->name_slots[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    set->name_slots[slot] = (uint32_t)set->count + 1;
+    return set->count;
+}
+
+// Writes the last `digits` base-62 digits of `value`, most significant first.
+static void put_base62(StringBuffer *sb, uint64_t value, size_t digits) {
+    static const char alphabet[] =
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char text[16];
+    for (size_t i = digits; i > 0; i--) {
+        text[i - 1] = alphabet[value % 62];
+        value /= 62;
+    }
+    sb_putsn(sb, text, digits);
+}
+
+// Declares one function pointer typedef per distinct signature among the
+// required commands, named after a hash of the signature, e.g. Fn3kZ9qa for
+// the 32-bit hash in six base-62 digits. Wrappers cast through these instead
+// of spelling out the type each time. Names don't depend on the order of the
+// commands, and adding or removing a command leaves the other names alone,
+// unless two signatures in the output share a 32-bit hash. Every signature in
+// such a group is named after a 64-bit hash in eleven digits instead, so its
+// name changes when the group gains or loses a member.
+static void declare_command_types(GenerationContext *ctx) {
+    SignatureSet set = { .text = sb_new_buffer() };
+    set.slot_count = 64;
+    while (set.slot_count < 2 * ctx->command_count) {
+        set.slot_count *= 2;
+    }
+    set.slots = mem_calloc(set.slot_count, sizeof(*set.slots));
+    set.name_slots = mem_calloc(set.slot_count, sizeof(*set.name_slots));
+
+    // The typedef names, back to back, and the one each command uses.
+    StringBuffer names = sb_new_buffer();
+    size_t *name_offsets = mem_calloc(ctx->command_count + 1, sizeof(size_t));
+    size_t *command_types = mem_calloc(ctx->command_count + 1, sizeof(size_t));
+    size_t *decl_offsets = mem_calloc(ctx->command_count + 1, sizeof(size_t));
+    // The first command with each signature, and whether its hash collides.
+    size_t *type_commands = mem_calloc(ctx->command_count + 1, sizeof(size_t));
+    bool *collides = mem_calloc(ctx->command_count + 1, sizeof(bool));
+
+    StringView no_name = { .start = "", .length = 0 };
+    for (size_t i = 0; i < ctx->command_count; i++) {
+        const Command *command = ctx->commands[i];
+
+        size_t start = set.text.length;
+        write_as_function_ptr_type(&set.text, ctx->registry, command, no_name);
+        StringView signature = {
+            .start = &set.text.ptr[start],
+            .length = set.text.length - start,
+        };
+
+        size_t slot = find_signature_slot(&set, signature);
+        if (set.slots[slot] != 0) {
+            set.text.length = start;
+            command_types[i] = set.slots[slot] - 1;
+            continue;
+        }
+
+        if (set.count >= set.capacity) {
+            set.capacity = set.capacity == 0 ? 64 : set.capacity * 2;
+            set.offsets =
+                mem_realloc(set.offsets, set.capacity * sizeof(*set.offsets));
+            set.lengths =
+                mem_realloc(set.lengths, set.capacity * sizeof(*set.lengths));
+            set.hashes =
+                mem_realloc(set.hashes, set.capacity * sizeof(*set.hashes));
+        }
+        uint32_t hash = sv_hash(signature);
+        size_t first = first_with_hash(&set, hash);
+        if (first != set.count) {
+            collides[first] = true;
+            collides[set.count] = true;
+        }
+        set.offsets[set.count] = start;
+        set.lengths[set.count] = signature.length;
+        set.hashes[set.count] = hash;
+        type_commands[set.count] = i;
+        set.slots[slot] = (uint32_t)++set.count;
+        command_types[i] = set.count - 1;
+    }
+
+    // Names are chosen once every collision is known.
+    for (size_t type = 0; type < set.count; type++) {
+        StringView signature = signature_at(&set, type);
+        name_offsets[type] = names.length;
+        sb_puts("Fn", &names);
+        if (collides[type]) {
+            put_base62(&names,
+                       xml_compact_hash(signature.start, signature.length), 11);
+        } else {
+            put_base62(&names, set.hashes[type], 6);
+        }
+        name_offsets[type + 1] = names.length;
+
+        StringView name = {
+            .start = &names.ptr[name_offsets[type]],
+            .length = names.length - name_offsets[type],
+        };
+        decl_offsets[type] = ctx->command_types.length;
+        sb_puts("typedef ", &ctx->command_types);
+        write_as_function_ptr_type(&ctx->command_types, ctx->registry,
+                                   ctx->commands[type_commands[type]], name);
+        sb_puts(";\n", &ctx->command_types);
+        decl_offsets[type + 1] = ctx->command_types.length;
+    }
+
+    // Only now has `names` stopped moving.
+    ctx->command_type_names =
+        mem_calloc(ctx->command_count + 1, sizeof(*ctx->command_type_names));
+    for (size_t i = 0; i < ctx->command_count; i++) {
+        size_t type = command_types[i];
+        ctx->command_type_names[i] = (StringView){
+            .start = &names.ptr[name_offsets[type]],
+            .length = name_offsets[type + 1] - name_offsets[type],
+        };
+    }
+    sb_free(ctx->type_names);
+    ctx->type_names = names;
+    mem_free(ctx->command_type_ids);
+    mem_free(ctx->type_decl_offsets);
+    ctx->command_type_ids = command_types;
+    ctx->type_decl_offsets = decl_offsets;
+    ctx->type_count = set.count;
+
+    mem_free(name_offsets);
+    mem_free(type_commands);
+    mem_free(collides);
+    sb_free(set.text);
+    mem_free(set.offsets);
+    mem_free(set.lengths);
+    mem_free(set.hashes);
+    mem_free(set.slots);
+    mem_free(set.name_slots);
+}
+
+// Puts each command's wrapper in the shard picked by a hash of its name, so
+// adding or removing a command never moves any other between shards. Within
+// a shard, commands keep their order and are numbered from 0, which is how
+// the shard's wrappers index its lookup table.
+static void assign_shards(GenerationContext *ctx) {
+    mem_free(ctx->command_shards);
+    mem_free(ctx->shard_indices);
+    ctx->command_shards = NULL;
+    ctx->shard_indices = NULL;
+    if (ctx->shards == 0) {
+        return;
+    }
+
+    size_t *counts = mem_calloc(ctx->shards, sizeof(*counts));
+    ctx->command_shards =
+        mem_calloc(ctx->command_count + 1, sizeof(*ctx->command_shards));
+    ctx->shard_indices =
+        mem_calloc(ctx->command_count + 1, sizeof(*ctx->shard_indices));
+    for (size_t i = 0; i < ctx->command_count; i++) {
+        size_t shard = sv_hash(ctx->commands[i]->name) % ctx->shards;
+        ctx->command_shards[i] = shard;
+        ctx->shard_indices[i] = counts[shard]++;
+    }
+    mem_free(counts);
+}
+
+// Generates the required commands on `ctx->jobs` threads. Each job takes a
+// contiguous run of commands and the buffers are joined in order, so the
+// output doesn't depend on the number of jobs.
+static void generate_commands(GenerationContext *ctx) {
+    size_t job_count = ctx->jobs;
+    if (job_count > ctx->command_count) {
+        job_count = ctx->command_count;
+    }
+    if (job_count < 1) {
+        job_count = 1;
+    }
+
+    mem_free(ctx->wrapper_ends);
+    ctx->wrapper_ends =
+        mem_calloc(ctx->command_count + 1, sizeof(*ctx->wrapper_ends));
+
+    CommandJob *jobs = mem_calloc(job_count, sizeof(*jobs));
+    Thread *threads = mem_calloc(job_count, sizeof(*threads));
+    size_t first = 0;
+    for (size_t i = 0; i < job_count; i++) {
+        size_t end = ctx->command_count * (i + 1) / job_count;
+        jobs[i] = (CommandJob){
+            .registry = ctx->registry,
+            .use_snake_case = ctx->use_snake_case,
+            .commands = &ctx->commands[first],
+            .type_names = &ctx->command_type_names[first],
+            .count = end - first,
+            .command_index = first,
+            .command_shards =
+                ctx->command_shards ? &ctx->command_shards[first] : NULL,
+            .shard_indices =
+                ctx->shard_indices ? &ctx->shard_indices[first] : NULL,
+            .command_lookup = sb_new_buffer(),
+            .command_wrappers = sb_new_buffer(),
+            .command_decls = sb_new_buffer(),
+            .wrapper_ends = &ctx->wrapper_ends[first],
+        };
+        first = end;
+    }
+
+    // The calling thread doubles as the first job, and takes over the jobs of
+    // any thread that fails to start.
+    size_t started = 1;
+    while (started < job_count &&
+           thread_start(&threads[started], run_command_job, &jobs[started])) {
+        started++;
+    }
+    run_command_job(&jobs[0]);
+    for (size_t i = started; i < job_count; i++) {
+        run_command_job(&jobs[i]);
+    }
+    for (size_t i = 1; i < started; i++) {
+        thread_join(&threads[i]);
+    }
+
+    // Nothing else writes these buffers, so the first job's can be taken over
+    // as they are.
+    sb_free(ctx->command_lookup);
+    sb_free(ctx->command_wrappers);
+    sb_free(ctx->command_decls);
+    ctx->command_lookup = jobs[0].command_lookup;
+    ctx->command_wrappers = jobs[0].command_wrappers;
+    ctx->command_decls = jobs[0].command_decls;
+    for (size_t i = 1; i < job_count; i++) {
+        // Each job counted from the start of its own buffer.
+        for (size_t j = 0; j < jobs[i].count; j++) {
+            jobs[i].wrapper_ends[j] += ctx->command_wrappers.length;
+        }
+        append_buffer(&ctx->command_lookup, jobs[i].command_lookup);
+        append_buffer(&ctx->command_wrappers, jobs[i].command_wrappers);
+        append_buffer(&ctx->command_decls, jobs[i].command_decls);
+    }
+
+    mem_free(jobs);
+    mem_free(threads);
+}
+
+void generate_command(GenerationContext *ctx, StringView name) {
+    const Command *command = registry_find_command(ctx->registry, name);
+    if (command == NULL) {
+        return;
+    }
+
+    keep_element(ctx, command->element, XML_WRITE_ALL);
+
+    if (ctx->command_count >= ctx->commands_capacity) {
+        ctx->commands_capacity =
+            ctx->commands_capacity == 0 ? 64 : ctx->commands_capacity * 2;
+        ctx->commands = mem_realloc(ctx->commands, ctx->commands_capacity *
+                                                   sizeof(*ctx->commands));
+    }
+    ctx->commands[ctx->command_count++] = command;
+}
+
+static bool is_version_leq(const Feature *feature, GLAPIType expected_api,
+                           GLVersion max_version) {
+    if (feature->api.start == NULL) {
+        fprintf(stderr,
+                "Generation error: expected attribute `api` on <feature>!\n");
+        return false;
+    }
+
+    if (gl_api_from_sv(feature->api) != expected_api)
+        return false;
+
+    if (feature->name.start == NULL) {
+        fprintf(stderr,
+                "Generation error: expected attribute `name` on <feature>!\n");
+        return false;
+    }
+
+    if (gl_version_from_sv(feature->name) > max_version)
+        return false;
+
+    return true;
+}
+
+static void register_require(GenerationContext *ctx, const FeatureBlock *block,
+                             bool require) {
+    const Definition *definitions =
+        &ctx->registry->definitions[block->first_definition];
+    for (size_t i = 0; i < block->definition_count; i++) {
+        const Definition *def = &definitions[i];
+
+        if (def->name.start == NULL) {
+            fprintf(stderr, "Generation error: expected `name` attribute!\n");
+            continue;
+        }
+
+        rl_add(&ctx->requirements, def->type, def->name, require);
+    }
+}
+
+// Returns the next block of the feature, starting at `*index`, that is a
+// <remove> if `remove` is set and a <require> otherwise.
+static const FeatureBlock *find_next_block(const Registry *registry,
+                                           const Feature *feature, bool remove,
+                                           size_t *index) {
+    while (*index < feature->block_count) {
+        const FeatureBlock *block =
+            &registry->blocks[feature->first_block + (*index)++];
+        if (block->remove == remove) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+static void gather_featureset(GenerationContext *ctx) {
+    const Registry *registry = ctx->registry;
+    size_t feature_index = 0;
+    for (GLVersion version = GL_VERSION_1_0; version <= ctx->version;
+         version++) {
+        // There are no more <feature> tags in the file.
+        if (feature_index >= registry->feature_count)
+            break;
+
+        const Feature *feature = &registry->features[feature_index++];
+
+        // Features are matched up with versions by position, so even the
+        // ones that are skipped have to stay in a pruned registry.
+        if (!is_version_leq(feature, ctx->api, ctx->version)) {
+            keep_element(ctx, feature->element, XML_WRITE_TAG);
+            continue;
+        }
+        keep_element(ctx, feature->element, XML_WRITE_FILTER);
+
+        // This is a bit cursed, but if it works...
+        for (size_t r_index = 0;;) {
+            bool require = true;
+            const FeatureBlock *r =
+                find_next_block(registry, feature, false, &r_index);
+            if (!r) {
+                r = find_next_block(registry, feature, true, &r_index);
+                require = false;
+            }
+
+            // Neither <require> nor <remove> could be found, exit the loop.
+            if (!r) {
+                break;
+            }
+
+            // TODO: Check whether one profile is a subset of the other!
+            if (r->profile.start != NULL &&
+                gl_profile_from_sv(r->profile) != ctx->profile) {
+                // Kept empty, as it decides which <remove>s are seen.
+                keep_element(ctx, r->element, XML_WRITE_TAG);
+                continue;
+            }
+            keep_element(ctx, r->element, XML_WRITE_ALL);
+
+            // If no profile is provided, then continue processing the tag
+            // regardless.
+            register_require(ctx, r, require);
+        }
+    }
+}
+
+static StringView into_string_view(StringBuffer str) {
+    return (StringView){
+        .start = str.ptr,
+        .length = str.length,
+    };
+}
+
+static bool holds_output(const xml_Input *file, const TemplateOutput *output) {
+    if (file->length != output->length) {
+        return false;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < output->slice_count; i++) {
+        StringView slice = output->slices[i];
+        if (memcmp(&file->data[offset], slice.start, slice.length) != 0) {
+            return false;
+        }
+        offset += slice.length;
+    }
+    return true;
+}
+
+// Replaces the file at `path` with `output`, unless it already holds exactly
+// those bytes, so that its timestamp only moves when its content does. The
+// slices are streamed to the file as they are, without joining them first. The
+// new file is written next to it and renamed into place, so a concurrent or
+// interrupted run never leaves a half-written output behind.
+static bool write_if_changed(const char *path, const TemplateOutput *output) {
+    FILE *fp = fopen(path, "rb");
+    if (fp != NULL) {
+        fclose(fp);
+
+        xml_Input existing;
+        if (xml_open_input(path, &existing)) {
+            bool unchanged = holds_output(&existing, output);
+            xml_close_input(&existing);
+            if (unchanged) {
+                return true;
+            }
+        }
+    }
+
+    size_t path_length = strlen(path);
+    char *temp_path = mem_malloc(path_length + sizeof(".tmp"));
+    memcpy(temp_path, path, path_length);
+    memcpy(&temp_path[path_length], ".tmp", sizeof(".tmp"));
+
+    fp = fopen(temp_path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "error: couldn't open `%s`!\n", temp_path);
+        mem_free(temp_path);
+        return false;
+    }
+
+    bool success = true;
+    for (size_t i = 0; success && i < output->slice_count; i++) {
+        StringView slice = output->slices[i];
+        success = fwrite(slice.start, 1, slice.length, fp) == slice.length;
+    }
+    success = fclose(fp) == 0 && success;
+
+#ifdef _WIN32
+    // `rename` doesn't replace existing files on Windows.
+    remove(path);
+#endif
+    success = success && rename(temp_path, path) == 0;
+    if (!success) {
+        fprintf(stderr, "error: couldn't write `%s`!\n", path);
+        remove(temp_path);
+    }
+
+    mem_free(temp_path);
+    return success;
+}
+
+static bool write_output_header(GenerationContext *ctx) {
+    StringView values[HEADER_VARIABLE_COUNT];
+    values[HEADER_TYPES] = into_string_view(ctx->types);
+    values[HEADER_ENUMS] = into_string_view(ctx->enums);
+    values[HEADER_COMMAND_DECLARATIONS] = into_string_view(ctx->command_decls);
+
+    double start = stats_now();
+    TemplateOutput built = template_build(&ctx->templates->header, values);
+    double built_at = stats_now();
+    bool success = write_if_changed(ctx->output_header, &built);
+    ctx->stats.seconds[STATS_TEMPLATES] += built_at - start;
+    ctx->stats.seconds[STATS_WRITE] += stats_now() - built_at;
+
+    template_output_free(&built);
+    return success;
+}
+
+static StringView sv_from_cstr(const char *str) {
+    StringView sv;
+    sv.start = str;
+    sv.length = convenient_strlen(str);
+    return sv;
+}
+
+// Without shards, the source holds one static lookup table and every wrapper.
+// With shards, it only holds one lookup table per shard, which the shard's
+// wrappers index directly through an extern declaration, so the tables can't
+// be static. Shards without commands get no table. `clad_init_gl` loads every
+// table through the list in LOOKUP_TABLES.
+static bool write_output_source(GenerationContext *ctx) {
+    StringView values[SOURCE_VARIABLE_COUNT];
+    values[SOURCE_COMMAND_TYPES] = into_string_view(ctx->command_types);
+    values[SOURCE_COMMAND_WRAPPERS] = into_string_view(ctx->command_wrappers);
+
+    StringBuffer lookup = sb_new_buffer();
+    StringBuffer tables = sb_new_buffer();
+    if (ctx->shards == 0) {
+        sb_puts("static Proc clad_lookup[] = {\n", &lookup);
+        sb_putsn(&lookup, ctx->command_lookup.ptr, ctx->command_lookup.length);
+        sb_puts("};", &lookup);
+        sb_printf(&tables, "    { clad_lookup, %zu },", ctx->command_count);
+    } else {
+        sb_reserve(&lookup, ctx->command_lookup.length);
+        for (size_t shard = 0; shard < ctx->shards; shard++) {
+            size_t count = 0;
+            for (size_t i = 0; i < ctx->command_count; i++) {
+                if (ctx->command_shards[i] != shard) {
+                    continue;
+                }
+                if (count++ == 0) {
+                    sb_printf(&lookup, "%sProc clad_lookup_%zu[] = {\n",
+                              lookup.length > 0 ? "\n" : "", shard);
+                }
+                put_lookup_entry(&lookup, ctx->commands[i]);
+            }
+            if (count == 0) {
+                continue;
+            }
+
+            sb_puts("};\n", &lookup);
+            sb_printf(&tables, "%s    { clad_lookup_%zu, %zu },",
+                      tables.length > 0 ? "\n" : "", shard, count);
+        }
+        if (lookup.length > 0) {
+            lookup.length--;
+        }
+
+        values[SOURCE_COMMAND_TYPES].length = 0;
+        values[SOURCE_COMMAND_WRAPPERS].length = 0;
+    }
+    values[SOURCE_COMMAND_LOOKUP] = into_string_view(lookup);
+    values[SOURCE_LOOKUP_TABLES] = into_string_view(tables);
+
+    double start = stats_now();
+    TemplateOutput built = template_build(&ctx->templates->source, values);
+    double built_at = stats_now();
+    bool success = write_if_changed(ctx->output_source, &built);
+    ctx->stats.seconds[STATS_TEMPLATES] += built_at - start;
+    ctx->stats.seconds[STATS_WRITE] += stats_now() - built_at;
+
+    template_output_free(&built);
+    sb_free(lookup);
+    sb_free(tables);
+    return success;
+}
+
+// The path of a shard is the source's with the shard's index added before the
+// extension, so "gl.c" has the shards "gl_0.c", "gl_1.c" and so on.
+static char *shard_path(const char *source, size_t index) {
+    const char *extension = strrchr(source, '.');
+    const char *separator = strrchr(source, '/');
+    if (extension == NULL || (separator != NULL && extension < separator)) {
+        extension = source + strlen(source);
+    }
+
+    size_t stem_length = (size_t)(extension - source);
+    size_t size = strlen(source) + 32;
+    char *path = mem_malloc(size);
+    snprintf(path, size, "%.*s_%zu%s", (int)stem_length, source, index,
+             extension);
+    return path;
+}
+
+// Spreads the wrappers across `ctx->shards` sources, as assign_shards picked.
+// A shard only holds its own wrappers and the typedefs they use, and indexes
+// its own lookup table, so adding or removing a command changes
+// the one shard it belongs to and the lookup source. Shards are only
+// rewritten when their content changes.
+static bool write_output_shards(GenerationContext *ctx) {
+    bool *declared = mem_calloc(ctx->type_count + 1, sizeof(*declared));
+    StringBuffer types = sb_new_buffer();
+    StringBuffer wrappers = sb_new_buffer();
+    bool success = true;
+    for (size_t shard = 0; shard < ctx->shards; shard++) {
+        double start = stats_now();
+
+        types.length = 0;
+        wrappers.length = 0;
+        memset(declared, 0, ctx->type_count * sizeof(*declared));
+        for (size_t i = 0; i < ctx->command_count; i++) {
+            if (ctx->command_shards[i] != shard) {
+                continue;
+            }
+
+            size_t from = i > 0 ? ctx->wrapper_ends[i - 1] : 0;
+            sb_putsn(&wrappers, &ctx->command_wrappers.ptr[from],
+                     ctx->wrapper_ends[i] - from);
+
+            size_t type = ctx->command_type_ids[i];
+            if (declared[type]) {
+                continue;
+            }
+            declared[type] = true;
+            size_t offset = ctx->type_decl_offsets[type];
+            sb_putsn(&types, &ctx->command_types.ptr[offset],
+                     ctx->type_decl_offsets[type + 1] - offset);
+        }
+
+        char index[32];
+        snprintf(index, sizeof(index), "%zu", shard);
+
+        StringView values[SHARD_VARIABLE_COUNT];
+        values[SHARD_INDEX] = sv_from_cstr(index);
+        values[SHARD_COMMAND_TYPES] = into_string_view(types);
+        values[SHARD_COMMAND_WRAPPERS] = into_string_view(wrappers);
+        TemplateOutput built = template_build(&ctx->templates->shard, values);
+        double built_at = stats_now();
+
+        char *path = shard_path(ctx->output_source, shard);
+        success = write_if_changed(path, &built) && success;
+        ctx->stats.seconds[STATS_TEMPLATES] += built_at - start;
+        ctx->stats.seconds[STATS_WRITE] += stats_now() - built_at;
+
+        mem_free(path);
+        template_output_free(&built);
+    }
+
+    sb_free(types);
+    sb_free(wrappers);
+    mem_free(declared);
+    return success;
+}
+
+static void generate_enum(GenerationContext *ctx, StringView name) {
+    for (const Enum *_enum = registry_find_enum(ctx->registry, name);
+         _enum != NULL; _enum = _enum->next) {
+        keep_element(ctx, _enum->block, XML_WRITE_FILTER);
+        keep_element(ctx, _enum->element, XML_WRITE_ALL);
+
+        ctx->stats.enums++;
+        sb_puts("#define ", &ctx->enums);
+        sb_put_sv(&ctx->enums, _enum->name);
+        sb_putc(' ', &ctx->enums);
+        sb_put_sv(&ctx->enums, _enum->value);
+        sb_putc('\n', &ctx->enums);
+    }
+}
+
+static int compare_kept(const void *a, const void *b) {
+    uintptr_t element_a = (uintptr_t)((const KeptElement *)a)->element;
+    uintptr_t element_b = (uintptr_t)((const KeptElement *)b)->element;
+    return (element_a > element_b) - (element_a < element_b);
+}
+
+static xml_WriteMode kept_mode(void *user, const xml_Token *element) {
+    KeptElements *kept = user;
+    KeptElement key = { .element = element };
+    KeptElement *found = bsearch(&key, kept->elements, kept->length,
+                                 sizeof(*kept->elements), compare_kept);
+    return found ? found->mode : XML_WRITE_SKIP;
+}
+
+// How much of an element each mode keeps. When several targets are written
+// into one pruned registry, each element is kept as completely as any of
+// them needs it.
+static int kept_rank(xml_WriteMode mode) {
+    switch (mode) {
+    case XML_WRITE_SKIP:
+        return 0;
+    case XML_WRITE_TAG:
+        return 1;
+    case XML_WRITE_FILTER:
+        return 2;
+    case XML_WRITE_ALL:
+        return 3;
+    }
+    return 0;
+}
+
+// Sorts the elements and merges duplicates, keeping the most complete mode.
+static void merge_kept(KeptElements *kept) {
+    qsort(kept->elements, kept->length, sizeof(*kept->elements), compare_kept);
+
+    size_t length = 0;
+    for (size_t i = 0; i < kept->length; i++) {
+        KeptElement element = kept->elements[i];
+        KeptElement *last = length > 0 ? &kept->elements[length - 1] : NULL;
+        if (last && last->element == element.element) {
+            if (kept_rank(element.mode) > kept_rank(last->mode)) {
+                last->mode = element.mode;
+            }
+            continue;
+        }
+        kept->elements[length++] = element;
+    }
+    kept->length = length;
+}
+
+// Writes the parts of the registry that generation read, so that generating
+// from the pruned registry with the same options gives the same output.
+static void write_output_registry(KeptElements *kept, xml_Document *doc,
+                                  const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "error: couldn't open `%s`!\n", path);
+        return;
+    }
+
+    merge_kept(kept);
+    if (!xml_write_document(doc, kept_mode, kept, file)) {
+        fprintf(stderr, "error: couldn't write `%s`!\n", path);
+    }
+    fclose(file);
+}
+
+// Without a usage list every definition is used. Commands also count as used
+// under their snake_case name.
+static bool is_used(GenerationContext *ctx, DefinitionType type,
+                    StringView name) {
+    if (ctx->usage == NULL || usage_contains(ctx->usage, name)) {
+        return true;
+    }
+    if (type != DEF_CMD) {
+        return false;
+    }
+
+    ctx->scratch.length = 0;
+    write_snake_case(&ctx->scratch, name);
+    StringView snake_case = {
+        .start = ctx->scratch.ptr,
+        .length = ctx->scratch.length,
+    };
+    return usage_contains(ctx->usage, snake_case);
+}
+
+static bool generate_target(GenerationContext *ctx) {
+    const Registry *registry = ctx->registry;
+    double *seconds = ctx->stats.seconds;
+
+    double start = stats_now();
+    generate_types(ctx);
+    double end = stats_now();
+    seconds[STATS_TYPES] += end - start;
+
+    start = end;
+    gather_featureset(ctx);
+    end = stats_now();
+    seconds[STATS_FEATURESET] += end - start;
+
+    start = end;
+    keep_element(ctx, registry->root, XML_WRITE_FILTER);
+    keep_element(ctx, registry->commands_element, XML_WRITE_FILTER);
+
+    for (size_t i = 0; i < ctx->requirements.length; i++) {
+        if (!ctx->requirements.required[i] ||
+            !is_used(ctx, ctx->requirements.types[i],
+                     ctx->requirements.names[i])) {
+            continue;
+        }
+
+        switch (ctx->requirements.types[i]) {
+        case DEF_ENUM:
+            generate_enum(ctx, ctx->requirements.names[i]);
+            break;
+        case DEF_CMD:
+            generate_command(ctx, ctx->requirements.names[i]);
+            break;
+        }
+    }
+    end = stats_now();
+    seconds[STATS_DEFINITIONS] += end - start;
+
+    start = end;
+    declare_command_types(ctx);
+    assign_shards(ctx);
+    generate_commands(ctx);
+    seconds[STATS_COMMANDS] += stats_now() - start;
+
+    ctx->stats.targets = 1;
+    ctx->stats.requirements = ctx->requirements.length;
+    ctx->stats.commands = ctx->command_count;
+
+    bool success = write_output_header(ctx);
+    if (ctx->shards > 0) {
+        success = write_output_shards(ctx) && success;
+    }
+    return write_output_source(ctx) && success;
+}
+
+typedef struct {
+    GenerationContext ctx;
+    bool success;
+} TargetJob;
+
+// The targets left to generate, shared by the threads that generate them.
+typedef struct {
+    TargetJob *jobs;
+    size_t count;
+    size_t next;
+    Mutex lock;
+} TargetQueue;
+
+// Takes targets off the queue until none are left.
+static void run_target_worker(void *arg) {
+    TargetQueue *queue = arg;
+    while (true) {
+        mutex_lock(&queue->lock);
+        size_t index = queue->next;
+        if (index < queue->count) {
+            queue->next++;
+        }
+        mutex_unlock(&queue->lock);
+
+        if (index >= queue->count) {
+            return;
+        }
+        TargetJob *job = &queue->jobs[index];
+        job->success = generate_target(&job->ctx);
+    }
+}
+
+// Generates every target from the one registry, on as many threads as --jobs
+// allows, or one per core without it. The threads are shared between the
+// targets running at once and their commands, so no more than that run in
+// total. `doc` is only needed, and may otherwise be NULL, when a pruned
+// registry is written. What the targets took and produced is added to `stats`.
+static bool generate(const Registry *registry, const Usage *usage,
+                     xml_Document *doc, CladOptions args, Stats *stats) {
+    double start = stats_now();
+    Templates templates;
+    bool loaded = load_templates(args, &templates);
+    stats->seconds[STATS_READ] += stats_now() - start;
+    if (!loaded) {
+        return false;
+    }
+
+    size_t job_count = args.target_count;
+    size_t thread_budget = args.jobs > 0 ? args.jobs : thread_cpu_count();
+    size_t worker_count = job_count < thread_budget ? job_count : thread_budget;
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    // Whatever the targets leave of --jobs goes to their commands.
+    size_t command_jobs = args.jobs > 0 ? args.jobs / worker_count : 1;
+
+    TargetJob *jobs = mem_calloc(job_count, sizeof(*jobs));
+    Thread *threads = mem_calloc(worker_count, sizeof(*threads));
+    for (size_t i = 0; i < job_count; i++) {
+        jobs[i].ctx = init_context(args, args.targets[i]);
+        jobs[i].ctx.registry = registry;
+        jobs[i].ctx.usage = usage;
+        jobs[i].ctx.templates = &templates;
+        jobs[i].ctx.jobs = command_jobs;
+    }
+
+    TargetQueue queue = { .jobs = jobs, .count = job_count };
+    mutex_init(&queue.lock);
+
+    // The calling thread doubles as the first worker, so the targets still
+    // get done if no other thread starts.
+    size_t started = 1;
+    while (started < worker_count &&
+           thread_start(&threads[started], run_target_worker, &queue)) {
+        started++;
+    }
+    run_target_worker(&queue);
+    for (size_t i = 1; i < started; i++) {
+        thread_join(&threads[i]);
+    }
+    mutex_destroy(&queue.lock);
+
+    bool success = true;
+    KeptElements kept = { 0 };
+    for (size_t i = 0; i < job_count; i++) {
+        success = success && jobs[i].success;
+        stats_add(stats, &jobs[i].ctx.stats);
+
+        KeptElements *job_kept = &jobs[i].ctx.kept;
+        if (kept.length + job_kept->length > kept.capacity) {
+            kept.capacity = kept.length + job_kept->length;
+            kept.elements = mem_realloc(kept.elements,
+                                        kept.capacity * sizeof(*kept.elements));
+        }
+        if (job_kept->length > 0) {
+            memcpy(&kept.elements[kept.length], job_kept->elements,
+                   job_kept->length * sizeof(*kept.elements));
+            kept.length += job_kept->length;
+        }
+        free_context(jobs[i].ctx);
+    }
+
+    if (args.output_registry) {
+        start = stats_now();
+        write_output_registry(&kept, doc, args.output_registry);
+        stats->seconds[STATS_WRITE] += stats_now() - start;
+    }
+
+    mem_free(kept.elements);
+    mem_free(jobs);
+    mem_free(threads);
+    free_templates(&templates);
+    return success;
+}
+
+static char *shift_arguments(char ***argv) {
+    char *next_string = **argv;
+    if (next_string != NULL) {
+        (*argv)++;
+    }
+    return next_string;
+}
+
+typedef enum { ARG_STRING, ARG_BOOL } ArgType;
+
+typedef struct {
+    ArgType type;
+    const char *flag;
+    void *dest;
+    bool optional;
+    // Describes the one target to generate, so it's given by the manifest
+    // instead when there is one.
+    bool target;
+    bool found;
+} Arg;
+
+static void print_arg(Arg arg, FILE *fp) {
+    fputs(arg.flag, fp);
+    if (arg.type == ARG_STRING) {
+        fputs(" <string>", fp);
+    }
+}
+
+static void print_clad_usage(Arg *arguments, size_t arg_count) {
+    fprintf(stderr, "Expected arguments:\n");
+
+    for (size_t i = 0; i < arg_count; i++) {
+        Arg arg = arguments[i];
+        fputc('\t', stderr);
+
+        if (arg.optional) {
+            fputc('[', stderr);
+        }
+
+        print_arg(arg, stderr);
+
+        if (arg.optional) {
+            fputc(']', stderr);
+        }
+
+        fputc('\n', stderr);
+    }
+}
+
+static bool parse_args(Arg *arguments, size_t count, char **argv) {
+    shift_arguments(&argv);
+    const char *next = NULL;
+
+    while ((next = shift_arguments(&argv))) {
+        if (convenient_streq(next, "\\")) {
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Arg *arg = &arguments[i];
+
+            if (!convenient_streq(next, arg->flag)) {
+                continue;
+            }
+
+            switch (arg->type) {
+            case ARG_STRING:
+                *(char **)arg->dest = shift_arguments(&argv);
+                break;
+            case ARG_BOOL:
+                *(bool *)arg->dest = true;
+                break;
+            }
+
+            arg->found = true;
+            break;
+        }
+    }
+
+    bool has_manifest = false;
+    for (size_t i = 0; i < count; i++) {
+        if (arguments[i].found &&
+            convenient_streq(arguments[i].flag, "--manifest")) {
+            has_manifest = true;
+        }
+    }
+
+    bool perfect_parse = true;
+
+    for (size_t i = 0; i < count; i++) {
+        Arg arg = arguments[i];
+        if (arg.target && has_manifest) {
+            if (arg.found) {
+                fprintf(stderr, "error: %s can't be used with --manifest\n",
+                        arg.flag);
+                perfect_parse = false;
+            }
+            continue;
+        }
+
+        if (arg.optional) {
+            continue;
+        }
+
+        if (!arg.found) {
+            fputs("error: missing argument: ", stderr);
+            print_arg(arg, stderr);
+            fputc('\n', stderr);
+            perfect_parse = false;
+        }
+    }
+
+    return perfect_parse;
+}
+
+static bool parse_target(const char *api, const char *profile,
+                         const char *version, Target *target) {
+    bool success = true;
+
+    // Parse OpenGL API
+    target->api = gl_api_from_sv(sv_from_cstr(api));
+    if (target->api == GL_API_INVALID) {
+        fprintf(stderr, "error: failed to parse API version: %s\n", api);
+        success = false;
+    }
+
+    // Parse OpenGL profile
+    target->profile = gl_profile_from_sv(sv_from_cstr(profile));
+    if (target->profile == GL_PROFILE_INVALID) {
+        fprintf(stderr, "error: failed to parse profile: %s\n", profile);
+        success = false;
+    }
+
+    // Parse OpenGL version
+    target->version = gl_version_from_sv_short(sv_from_cstr(version));
+    if (target->version == GL_VERSION_INVALID) {
+        fprintf(stderr, "error: failed to parse version: %s\n", version);
+        success = false;
+    }
+
+    return success;
+}
+
+static void add_target(CladOptions *opts, Target target) {
+    opts->targets = mem_realloc(opts->targets, (opts->target_count + 1) *
+                                               sizeof(*opts->targets));
+    opts->targets[opts->target_count++] = target;
+}
+
+// Returns an output of `target` that is the target's other output or one of
+// the earlier targets', or NULL. Targets are generated in parallel, so two of
+// them writing one file would race. Paths are compared as written.
+static const char *find_shared_output(const CladOptions *opts, Target target) {
+    if (convenient_streq(target.output_header, target.output_source)) {
+        return target.output_header;
+    }
+
+    const char *outputs[] = { target.output_header, target.output_source };
+    for (size_t i = 0; i < opts->target_count; i++) {
+        for (size_t j = 0; j < sizeof(outputs) / sizeof(*outputs); j++) {
+            if (convenient_streq(outputs[j], opts->targets[i].output_header) ||
+                convenient_streq(outputs[j], opts->targets[i].output_source)) {
+                return outputs[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Reads a manifest with one target per line:
+//
+//     <api> <profile> <version> <out-header> <out-source> [snake-case]
+//
+// Blank lines and lines starting with `#` are skipped. Fields are separated by
+// spaces or tabs and can't contain any; paths are relative to the working
+// directory and no two outputs can share one. The fields are terminated in
+// place, so the targets point into `opts->manifest`.
+static bool parse_manifest(const char *path, CladOptions *opts) {
+    opts->manifest = xml_read_file(path);
+    if (opts->manifest == NULL) {
+        return false;
+    }
+
+    bool success = true;
+    char *cursor = opts->manifest;
+    for (size_t line = 1; *cursor != '\0'; line++) {
+        char *fields[7];
+        size_t field_count = 0;
+
+        while (*cursor != '\0' && *cursor != '\n') {
+            while (is_blank(*cursor)) {
+                *cursor++ = '\0';
+            }
+            if (*cursor == '\0' || *cursor == '\n') {
+                break;
+            }
+
+            if (field_count < sizeof(fields) / sizeof(*fields)) {
+                fields[field_count] = cursor;
+            }
+            field_count++;
+
+            while (*cursor != '\0' && *cursor != '\n' && !is_blank(*cursor)) {
+                cursor++;
+            }
+        }
+        if (*cursor == '\n') {
+            *cursor++ = '\0';
+        }
+
+        if (field_count == 0 || fields[0][0] == '#') {
+            continue;
+        }
+
+        bool snake_case = field_count == 6 &&
+                          convenient_streq(fields[5], "snake-case");
+        if (field_count != 5 && !snake_case) {
+            fprintf(stderr,
+                    "error: %s:%zu: expected `<api> <profile> <version> "
+                    "<out-header> <out-source> [snake-case]`\n",
+                    path, line);
+            success = false;
+            continue;
+        }
+
+        Target target = {
+            .output_header = fields[3],
+            .output_source = fields[4],
+            .use_snake_case = snake_case,
+        };
+        if (!parse_target(fields[0], fields[1], fields[2], &target)) {
+            fprintf(stderr, "error: %s:%zu: invalid target\n", path, line);
+            success = false;
+            continue;
+        }
+
+        const char *shared = find_shared_output(opts, target);
+        if (shared != NULL) {
+            fprintf(stderr, "error: %s:%zu: `%s` is written twice\n", path,
+                    line, shared);
+            success = false;
+            continue;
+        }
+        add_target(opts, target);
+    }
+
+    if (success && opts->target_count == 0) {
+        fprintf(stderr, "error: %s: no targets\n", path);
+        success = false;
+    }
+
+    return success;
+}
+
+static CladOptions parse_raw_args(RawArguments raw_args) {
+    CladOptions opts = {
+        .input_xml = raw_args.input_xml,
+        .header_template_path = raw_args.header_template,
+        .source_template_path = raw_args.source_template,
+        .registry_cache = raw_args.registry_cache,
+        .output_registry = raw_args.output_registry,
+        .stamp = raw_args.stamp,
+        .usage = raw_args.usage,
+        .shard_template_path = raw_args.shard_template,
+        .stats = raw_args.stats,
+        .stats_json = raw_args.stats_json,
+        .parsed_succesfully = true,
+    };
+
+    if (raw_args.manifest) {
+        opts.parsed_succesfully = parse_manifest(raw_args.manifest, &opts);
+    } else {
+        Target target = {
+            .output_header = raw_args.output_header,
+            .output_source = raw_args.output_source,
+            .use_snake_case = raw_args.use_snake_case,
+        };
+        opts.parsed_succesfully = parse_target(raw_args.api, raw_args.profile,
+                                               raw_args.version, &target);
+        add_target(&opts, target);
+    }
+
+    // Parse the number of code generation jobs
+    if (raw_args.jobs) {
+        char *end = NULL;
+        unsigned long jobs = strtoul(raw_args.jobs, &end, 10);
+        if (*raw_args.jobs == '\0' || *end != '\0' || jobs == 0 ||
+            jobs > 256) {
+            fprintf(stderr, "error: failed to parse job count: %s\n",
+                    raw_args.jobs);
+            opts.parsed_succesfully = false;
+        } else {
+            opts.jobs = jobs;
+        }
+    }
+
+    // Parse the number of wrapper shards
+    if (raw_args.shards) {
+        char *end = NULL;
+        unsigned long shards = strtoul(raw_args.shards, &end, 10);
+        if (*raw_args.shards == '\0' || *end != '\0' || shards == 0 ||
+            shards > 256) {
+            fprintf(stderr, "error: failed to parse shard count: %s\n",
+                    raw_args.shards);
+            opts.parsed_succesfully = false;
+        } else if (raw_args.shard_template == NULL) {
+            fprintf(stderr, "error: --shards needs --shard-template\n");
+            opts.parsed_succesfully = false;
+        } else {
+            opts.shards = shards;
+        }
+    }
+
+    return opts;
+}
+
+void generator_free_options(CladOptions opts) {
+    mem_free(opts.targets);
+    mem_free(opts.manifest);
+}
+
+CladOptions generator_parse_arguments(char **argv) {
+    RawArguments raw_args = { 0 };
+
+    Arg arguments[] = {
+        {
+            .type = ARG_BOOL,
+            .flag = "--snake-case",
+            .target = true,
+            .optional = true,
+            .dest = &raw_args.use_snake_case,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--in-xml",
+            .dest = &raw_args.input_xml,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--out-header",
+            .target = true,
+            .dest = &raw_args.output_header,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--out-source",
+            .target = true,
+            .dest = &raw_args.output_source,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--api",
+            .target = true,
+            .dest = &raw_args.api,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--profile",
+            .target = true,
+            .dest = &raw_args.profile,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--version",
+            .target = true,
+            .dest = &raw_args.version,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--header-template",
+            .dest = &raw_args.header_template,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--source-template",
+            .dest = &raw_args.source_template,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--registry-cache",
+            .optional = true,
+            .dest = &raw_args.registry_cache,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--out-registry",
+            .optional = true,
+            .dest = &raw_args.output_registry,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--jobs",
+            .optional = true,
+            .dest = &raw_args.jobs,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--stamp",
+            .optional = true,
+            .dest = &raw_args.stamp,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--manifest",
+            .optional = true,
+            .dest = &raw_args.manifest,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--usage",
+            .optional = true,
+            .dest = &raw_args.usage,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--shards",
+            .optional = true,
+            .dest = &raw_args.shards,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--shard-template",
+            .optional = true,
+            .dest = &raw_args.shard_template,
+        },
+        {
+            .type = ARG_BOOL,
+            .flag = "--stats",
+            .optional = true,
+            .dest = &raw_args.stats,
+        },
+        {
+            .type = ARG_STRING,
+            .flag = "--stats-json",
+            .optional = true,
+            .dest = &raw_args.stats_json,
+        },
+    };
+
+    size_t arg_count = sizeof(arguments) / sizeof(*arguments);
+
+    CladOptions opts = { 0 };
+    if (!parse_args(arguments, arg_count, argv)) {
+        return opts;
+    }
+
+    opts = parse_raw_args(raw_args);
+
+    if (!opts.parsed_succesfully) {
+        print_clad_usage(arguments, arg_count);
+    }
+
+    return opts;
+}
+
+static bool file_exists(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    fclose(fp);
+    return true;
+}
+
+// Hashes the contents of the file at `path`, or gives 0 if it can't be read.
+static uint64_t hash_file(const char *path) {
+    xml_Input input;
+    if (!file_exists(path) || !xml_open_input(path, &input)) {
+        return 0;
+    }
+
+    uint64_t hash = xml_compact_hash(input.data, input.length);
+    xml_close_input(&input);
+    return hash;
+}
+
+// Hashes the running executable, so that rebuilding the generator invalidates
+// the stamp. The path it was run through, `argv0`, is only a fallback for
+// platforms that can't name the executable, since a bare name found through
+// PATH can't be opened. Gives 0 if the executable can't be read.
+static uint64_t hash_generator(const char *argv0) {
+#if defined(_WIN32)
+    char path[MAX_PATH];
+    DWORD length = GetModuleFileNameA(NULL, path, sizeof(path));
+    if (length > 0 && length < sizeof(path)) {
+        return hash_file(path);
+    }
+#elif defined(__linux__)
+    uint64_t hash = hash_file("/proc/self/exe");
+    if (hash != 0) {
+        return hash;
+    }
+#endif
+    return argv0 ? hash_file(argv0) : 0;
+}
+
+// Identifies one run of the generator: everything that goes into its outputs,
+// and the outputs themselves.
+static uint64_t generation_key(CladOptions opts, uint64_t registry_hash,
+                               const Usage *usage, uint64_t generator_hash) {
+    StringBuffer sb = sb_new_buffer();
+
+    sb_puts(CLAD_GENERATOR_VERSION "\n", &sb);
+    sb_printf(&sb, "%016llx\n%016llx\n%016llx\n%016llx\n",
+              (unsigned long long)generator_hash,
+              (unsigned long long)registry_hash,
+              (unsigned long long)hash_file(opts.header_template_path),
+              (unsigned long long)hash_file(opts.source_template_path));
+    if (usage != NULL) {
+        sb_printf(&sb, "usage %016llx\n", (unsigned long long)usage->hash);
+    }
+    if (opts.shards > 0) {
+        sb_printf(&sb, "shards %zu %016llx\n", opts.shards,
+                  (unsigned long long)hash_file(opts.shard_template_path));
+    }
+    sb_puts(opts.output_registry ? opts.output_registry : "", &sb);
+    sb_putc('\n', &sb);
+
+    for (size_t i = 0; i < opts.target_count; i++) {
+        Target target = opts.targets[i];
+        sb_printf(&sb, "%d %d %d %d\n", (int)target.api, (int)target.profile,
+                  (int)target.version, (int)target.use_snake_case);
+        sb_puts(target.output_header, &sb);
+        sb_putc('\n', &sb);
+        sb_puts(target.output_source, &sb);
+        sb_putc('\n', &sb);
+    }
+
+    uint64_t key = xml_compact_hash(sb.ptr, sb.length);
+    sb_free(sb);
+    return key;
+}
+
+static void format_stamp(uint64_t key, char *buffer, size_t size) {
+    snprintf(buffer, size, "%016llx\n", (unsigned long long)key);
+}
+
+// The outputs are up to date if the stamp was written for the same key and
+// none of them has been deleted since.
+static bool is_up_to_date(CladOptions opts, uint64_t key) {
+    char expected[32];
+    format_stamp(key, expected, sizeof(expected));
+
+    FILE *fp = fopen(opts.stamp, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    char stamp[32] = { 0 };
+    size_t length = fread(stamp, 1, sizeof(stamp) - 1, fp);
+    fclose(fp);
+
+    if (length != strlen(expected) || memcmp(stamp, expected, length) != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < opts.target_count; i++) {
+        if (!file_exists(opts.targets[i].output_header) ||
+            !file_exists(opts.targets[i].output_source)) {
+            return false;
+        }
+
+        for (size_t shard = 0; shard < opts.shards; shard++) {
+            char *path = shard_path(opts.targets[i].output_source, shard);
+            bool exists = file_exists(path);
+            mem_free(path);
+            if (!exists) {
+                return false;
+            }
+        }
+    }
+    return !opts.output_registry || file_exists(opts.output_registry);
+}
+
+// Always rewritten, so that build systems comparing timestamps see the run as
+// done even when none of the outputs changed.
+static bool write_stamp(const char *path, uint64_t key) {
+    char stamp[32];
+    format_stamp(key, stamp, sizeof(stamp));
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "error: couldn't open `%s`!\n", path);
+        return false;
+    }
+    bool success = fputs(stamp, fp) >= 0;
+    success = fclose(fp) == 0 && success;
+    if (!success) {
+        fprintf(stderr, "error: couldn't write `%s`!\n", path);
+    }
+    return success;
+}
+
+// Maps the registry image at `path` if it was saved from this very registry.
+static bool open_registry_cache(const char *path, const xml_Input *registry,
+                                uint64_t key, xml_Input *cache,
+                                xml_CompactDom *dom) {
+    // A missing cache is the normal first run, not an error.
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    fclose(fp);
+
+    if (!xml_open_input(path, cache)) {
+        return false;
+    }
+
+    if (!xml_compact_view(registry->data, registry->length, key, cache->data,
+                          cache->length, dom)) {
+        xml_close_input(cache);
+        return false;
+    }
+
+    return true;
+}
+
+// Parses the whole registry and saves it as an image at `path`. A cache that
+// can't be written only costs the next run its speed-up.
+static bool parse_and_cache_registry(const char *path,
+                                     const xml_Input *registry, uint64_t key,
+                                     xml_Document *doc) {
+    xml_ParseOptions parse_options = { .lazy = false };
+    if (!xml_parse_file(registry->data, registry->length, parse_options, doc)) {
+        return false;
+    }
+
+    xml_CompactDom dom;
+    if (xml_compact_build(registry->data, doc->root, &dom)) {
+        xml_compact_save(&dom, registry->length, key, path);
+        xml_compact_free(&dom);
+    }
+
+    return true;
+}
+
+bool generator_run(CladOptions opts, const char *generator, Stats *stats) {
+    bool success = false;
+
+    double start = stats_now();
+    xml_Input input;
+    if (!xml_open_input(opts.input_xml, &input)) {
+        return false;
+    }
+
+    Usage usage;
+    const Usage *used = NULL;
+    if (opts.usage) {
+        if (!usage_load(opts.usage, &usage)) {
+            xml_close_input(&input);
+            return false;
+        }
+        used = &usage;
+    }
+    double end = stats_now();
+    stats->seconds[STATS_READ] += end - start;
+
+    start = end;
+    uint64_t registry_hash = 0;
+    if (opts.registry_cache || opts.stamp) {
+        registry_hash = xml_compact_hash(input.data, input.length);
+    }
+
+    uint64_t key = 0;
+    if (opts.stamp) {
+        uint64_t generator_hash = hash_generator(generator);
+        key = generation_key(opts, registry_hash, used, generator_hash);
+        // Without the executable's hash a rebuilt generator would look up to
+        // date, so everything is generated again. Outputs that come out the
+        // same still aren't rewritten.
+        if (generator_hash != 0 && is_up_to_date(opts, key)) {
+            success = write_stamp(opts.stamp, key);
+            goto done;
+        }
+    }
+    end = stats_now();
+    stats->seconds[STATS_STAMP] += end - start;
+
+    start = end;
+    xml_Document doc;
+    bool parsed;
+    xml_Input cache = { 0 };
+    xml_CompactDom dom;
+    if (opts.registry_cache) {
+        if (open_registry_cache(opts.registry_cache, &input, registry_hash,
+                                &cache, &dom)) {
+            parsed = xml_load_compact(&dom, input.length, &doc);
+        } else {
+            parsed = parse_and_cache_registry(opts.registry_cache, &input,
+                                              registry_hash, &doc);
+        }
+    } else {
+        xml_ParseOptions parse_options = { .lazy = true };
+        parsed = xml_parse_file(input.data, input.length, parse_options, &doc);
+    }
+
+    end = stats_now();
+    stats->seconds[STATS_PARSE] += end - start;
+
+    start = end;
+    Registry registry;
+    bool built = parsed && registry_build(&doc, &registry);
+    stats->seconds[STATS_REGISTRY] += stats_now() - start;
+    if (built) {
+        // Generation only reads the registry, so unless a pruned copy has to
+        // be written the document can go right away.
+        xml_Document *pruned = NULL;
+        if (opts.output_registry) {
+            pruned = &doc;
+        } else {
+            xml_free(&doc);
+        }
+
+        bool generated = generate(&registry, used, pruned, opts, stats);
+        if (pruned) {
+            xml_free(pruned);
+        }
+        registry_free(&registry);
+
+        success = generated && (!opts.stamp || write_stamp(opts.stamp, key));
+    } else if (parsed) {
+        xml_free(&doc);
+    }
+
+    if (cache.data != NULL) {
+        xml_close_input(&cache);
+    }
+
+done:
+    if (used) {
+        usage_free(&usage);
+    }
+    xml_close_input(&input);
+    return success;
+}
@@ -0,0 +1,103 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// The generator's whole pipeline, from the command line to the written
+// outputs, shared by clad_generator and clad_gen_bench.
+
+#define GL_VERSIONS                                                            \
+    X(GL_VERSION_1_0, 1.0)                                                     \
+    X(GL_VERSION_1_1, 1.1)                                                     \
+    X(GL_VERSION_1_2, 1.2)                                                     \
+    X(GL_VERSION_1_3, 1.3)                                                     \
+    X(GL_VERSION_1_4, 1.4)                                                     \
+    X(GL_VERSION_1_5, 1.5)                                                     \
+    X(GL_VERSION_2_0, 2.0)                                                     \
+    X(GL_VERSION_2_1, 2.1)                                                     \
+    X(GL_VERSION_3_0, 3.0)                                                     \
+    X(GL_VERSION_3_1, 3.1)                                                     \
+    X(GL_VERSION_3_2, 3.2)                                                     \
+    X(GL_VERSION_3_3, 3.3)                                                     \
+    X(GL_VERSION_4_0, 4.0)                                                     \
+    X(GL_VERSION_4_1, 4.1)                                                     \
+    X(GL_VERSION_4_2, 4.2)                                                     \
+    X(GL_VERSION_4_3, 4.3)                                                     \
+    X(GL_VERSION_4_4, 4.4)                                                     \
+    X(GL_VERSION_4_5, 4.5)                                                     \
+    X(GL_VERSION_4_6, 4.6)
+
+typedef enum {
+#define X(version, short) version,
+    GL_VERSIONS
+#undef X
+        GL_VERSION_INVALID,
+} GLVersion;
+
+typedef enum {
+    GL_API_GL,
+    GL_API_GLES1,
+    GL_API_GLES2,
+    GL_API_GLSC2,
+    GL_API_INVALID,
+} GLAPIType;
+
+typedef enum {
+    GL_PROFILE_CORE,
+    GL_PROFILE_COMPATIBILITY,
+    GL_PROFILE_INVALID,
+} GLProfile;
+
+// One configuration to generate a header and source for.
+typedef struct {
+    const char *output_header;
+    const char *output_source;
+    GLAPIType api;
+    GLProfile profile;
+    GLVersion version;
+    bool use_snake_case;
+} Target;
+
+typedef struct {
+    const char *input_xml;
+    const char *header_template_path;
+    const char *source_template_path;
+    const char *registry_cache;
+    const char *output_registry;
+    // The most threads to generate with, or 0 if not given: then a manifest
+    // runs a target on every core, and a single target runs on one thread.
+    size_t jobs;
+    const char *stamp;
+    const char *usage;
+    // The number of sources the wrappers are spread across, or 0 to keep them
+    // in the one source.
+    size_t shards;
+    const char *shard_template_path;
+    // Print the time spent in each phase to stderr, or write it as JSON to
+    // `stats_json`.
+    bool stats;
+    const char *stats_json;
+
+    // Either the target given on the command line, or every target listed in
+    // the manifest, whose paths point into `manifest`.
+    Target *targets;
+    size_t target_count;
+    char *manifest;
+
+    bool parsed_succesfully;
+} CladOptions;
+
+// Parses the generator's command line. The options must be freed with
+// generator_free_options even if `parsed_succesfully` is false.
+CladOptions generator_parse_arguments(char **argv);
+void generator_free_options(CladOptions opts);
+
+// Reads the registry, generates every target and writes the outputs.
+// `generator` is the path the generator was run through, used for the stamp
+// where the running executable can't be found otherwise, and may be NULL. The
+// time spent in each phase is added to `stats`.
+bool generator_run(CladOptions opts, const char *generator, Stats *stats);
+
+#endif
@@ -0,0 +1,36 @@
+#include "mem.h"
+#include <stdlib.h>
+
+static MemHooks hooks;
+static const MemHooks *current;
+
+void mem_set_hooks(const MemHooks *new_hooks) {
+    if (new_hooks == NULL) {
+        current = NULL;
+        return;
+    }
+    hooks = *new_hooks;
+    current = &hooks;
+}
+
+void *mem_malloc(size_t size) {
+    return current ? current->malloc(current->user, size) : malloc(size);
+}
+
+void *mem_calloc(size_t count, size_t size) {
+    return current ? current->calloc(current->user, count, size)
+                   : calloc(count, size);
+}
+
+void *mem_realloc(void *ptr, size_t size) {
+    return current ? current->realloc(current->user, ptr, size)
+                   : realloc(ptr, size);
+}
+
+void mem_free(void *ptr) {
+    if (current) {
+        current->free(current->user, ptr);
+    } else {
+        free(ptr);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+
+// Every allocation the generator makes goes through these, so that a caller
+// can plug in hooks to count or redirect them. Without hooks they are the C
+// library's functions.
+typedef struct {
+    void *(*malloc)(void *user, size_t size);
+    void *(*calloc)(void *user, size_t count, size_t size);
+    void *(*realloc)(void *user, void *ptr, size_t size);
+    void (*free)(void *user, void *ptr);
+    void *user;
+} MemHooks;
+
+// Has to be called before any other thread allocates, and memory has to be
+// freed through the hooks it was allocated with. NULL restores the defaults.
+void mem_set_hooks(const MemHooks *hooks);
+
+void *mem_malloc(size_t size);
+void *mem_calloc(size_t count, size_t size);
+void *mem_realloc(void *ptr, size_t size);
+void mem_free(void *ptr);
+
+#endif
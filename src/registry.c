@@ -0,0 +1,468 @@
+#include "registry.h"
+#include "mem.h"
+#include "string_buffer.h"
+#include <string.h>
+
+// Tag and attribute names the registry is built from. They are resolved to
+// atoms once per document so that every lookup is a single integer compare.
+#define ATOM_NAMES                                                             \
+    X(api, "api")                                                              \
+    X(command, "command")                                                      \
+    X(commands, "commands")                                                    \
+    X(enum_, "enum")                                                           \
+    X(enums, "enums")                                                          \
+    X(feature, "feature")                                                      \
+    X(name, "name")                                                            \
+    X(param, "param")                                                          \
+    X(profile, "profile")                                                      \
+    X(proto, "proto")                                                          \
+    X(remove, "remove")                                                        \
+    X(require, "require")                                                      \
+    X(type, "type")                                                            \
+    X(types, "types")                                                          \
+    X(value, "value")
+
+typedef struct {
+#define X(field, name) xml_Atom field;
+    ATOM_NAMES
+#undef X
+} Atoms;
+
+typedef struct {
+    // The document is parsed lazily, so the content of an element has to be
+    // reached through `content_of`, which expands it on first access.
+    xml_Document *doc;
+    Atoms atoms;
+    Registry *registry;
+
+    // Capacities of the registry's arrays.
+    size_t types_capacity;
+    size_t enums_capacity;
+    size_t commands_capacity;
+    size_t params_capacity;
+    size_t features_capacity;
+    size_t blocks_capacity;
+    size_t definitions_capacity;
+
+    // Text is decoded here before being copied into the registry's arena.
+    StringBuffer scratch;
+} BuildContext;
+
+static void *reserve(void *items, size_t *capacity, size_t length,
+                     size_t size) {
+    if (length < *capacity) {
+        return items;
+    }
+    *capacity = *capacity == 0 ? 64 : *capacity * 2;
+    return mem_realloc(items, *capacity * size);
+}
+
+#define PUSH(ctx, array, count, capacity)                                      \
+    ((ctx)->registry->array =                                                  \
+         reserve((ctx)->registry->array, &(ctx)->capacity,                     \
+                 (ctx)->registry->count,                                       \
+                 sizeof(*(ctx)->registry->array)),                             \
+     &(ctx)->registry->array[(ctx)->registry->count++])
+
+static xml_ContentList *content_of(BuildContext *ctx, xml_Token *token) {
+    if (token->value.content.unparsed != NULL) {
+        xml_expand(ctx->doc, token);
+    }
+    return &token->value.content;
+}
+
+static bool is_element(const xml_Token *token, xml_Atom tag) {
+    return token->type == XML_TOKEN_NODE &&
+           token->value.content.tag.atom == tag;
+}
+
+static xml_Token *find_next(BuildContext *ctx, xml_Token *parent,
+                            xml_Atom tag, size_t *index) {
+    size_t local_index = 0;
+
+    if (index == NULL) {
+        index = &local_index;
+    }
+
+    xml_ContentList *content = content_of(ctx, parent);
+    while (*index < content->length) {
+        xml_Token *child = &content->tokens[(*index)++];
+        if (is_element(child, tag)) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+// Returns the attribute's value, or a view with a NULL `start` if it's missing.
+static StringView attribute(xml_Token *token, xml_Atom name) {
+    StringView value = { 0 };
+    if (!xml_get_attribute_atom(*token, name, &value)) {
+        value.start = NULL;
+    }
+    return value;
+}
+
+static void put_xml_string_view(StringBuffer *file, StringView str) {
+    size_t i = 0;
+    while (i < str.length) {
+        if (str.start[i] == '&') {
+            StringView substr = { .start = &str.start[i],
+                                  .length = str.length - i };
+
+            if (sv_starts_with_cstr(substr, "&quot;")) {
+                sb_putc('"', file);
+                i += 6;
+                continue;
+            } else if (sv_starts_with_cstr(substr, "&apos;")) {
+                sb_putc('\'', file);
+                i += 6;
+                continue;
+            } else if (sv_starts_with_cstr(substr, "&lt;")) {
+                sb_putc('<', file);
+                i += 4;
+                continue;
+            } else if (sv_starts_with_cstr(substr, "&gt;")) {
+                sb_putc('>', file);
+                i += 4;
+                continue;
+            } else if (sv_starts_with_cstr(substr, "&amp;")) {
+                sb_putc('&', file);
+                i += 5;
+                continue;
+            }
+        }
+
+        sb_putc(str.start[i], file);
+        i++;
+    }
+}
+
+static void write_inner_text(BuildContext *ctx, StringBuffer *buffer,
+                             xml_Token *token, int count) {
+    switch (token->type) {
+    case XML_TOKEN_TEXT:
+        put_xml_string_view(buffer, token->value.text);
+        break;
+    case XML_TOKEN_NODE: {
+        xml_ContentList *content = content_of(ctx, token);
+        size_t max = (count < 0) ? content->length : (size_t)count;
+        for (size_t i = 0; i < max; i++) {
+            write_inner_text(ctx, buffer, &content->tokens[i], -1);
+        }
+        break;
+    }
+    }
+}
+
+// The decoded text of the first `count` children of `token`, or of all of them
+// if `count` is negative. Almost all of gl.xml is a single run of plain text,
+// which is returned as is instead of being copied.
+static StringView inner_text(BuildContext *ctx, xml_Token *token, int count) {
+    xml_ContentList *content = content_of(ctx, token);
+    size_t max = (count < 0) ? content->length : (size_t)count;
+
+    if (max == 1 && content->tokens[0].type == XML_TOKEN_TEXT) {
+        StringView text = content->tokens[0].value.text;
+        if (memchr(text.start, '&', text.length) == NULL) {
+            return text;
+        }
+    }
+
+    ctx->scratch.length = 0;
+    write_inner_text(ctx, &ctx->scratch, token, count);
+
+    StringView text = { .start = "", .length = ctx->scratch.length };
+    if (text.length > 0) {
+        char *copy = arena_alloc(&ctx->registry->arena, text.length);
+        memcpy(copy, ctx->scratch.ptr, text.length);
+        text.start = copy;
+    }
+    return text;
+}
+
+static void add_types(BuildContext *ctx, xml_Token *types) {
+    xml_ContentList *content = content_of(ctx, types);
+    for (size_t i = 0; i < content->length; i++) {
+        xml_Token *token = &content->tokens[i];
+        if (!is_element(token, ctx->atoms.type)) {
+            continue;
+        }
+
+        Type *type = PUSH(ctx, types, type_count, types_capacity);
+        type->text = inner_text(ctx, token, -1);
+    }
+}
+
+static void add_enums(BuildContext *ctx, xml_Token *enums) {
+    size_t enum_index = 0;
+    xml_Token *element = NULL;
+
+    while ((element = find_next(ctx, enums, ctx->atoms.enum_, &enum_index))) {
+        Enum *_enum = PUSH(ctx, enums, enum_count, enums_capacity);
+        *_enum = (Enum){
+            .name = attribute(element, ctx->atoms.name),
+            .value = attribute(element, ctx->atoms.value),
+            .element = element,
+            .block = enums,
+        };
+    }
+}
+
+static bool add_command(BuildContext *ctx, xml_Token *element) {
+    size_t tag_index = 0;
+    xml_Token *proto = find_next(ctx, element, ctx->atoms.proto, &tag_index);
+    if (proto == NULL) {
+        fprintf(stderr, "Generation error: expected <proto> in <command>!\n");
+        return false;
+    }
+
+    xml_Token *name = find_next(ctx, proto, ctx->atoms.name, NULL);
+    if (name == NULL) {
+        fprintf(stderr, "Generation error: expected <name> in <proto>!\n");
+        return false;
+    }
+
+    Command *command = PUSH(ctx, commands, command_count, commands_capacity);
+    xml_ContentList *proto_content = content_of(ctx, proto);
+    xml_Token *first = &proto_content->tokens[0];
+
+    command->name = inner_text(ctx, name, -1);
+    // The name is always the last part of the prototype.
+    command->return_type = inner_text(ctx, proto, proto_content->length - 1);
+    command->returns_void = first->type == XML_TOKEN_TEXT &&
+                            sv_equal_cstr(first->value.text, "void ");
+    command->first_param = ctx->registry->param_count;
+    command->element = element;
+
+    xml_Token *next_param = NULL;
+    while ((next_param =
+                find_next(ctx, element, ctx->atoms.param, &tag_index))) {
+        Param *param = PUSH(ctx, params, param_count, params_capacity);
+        param->declaration = inner_text(ctx, next_param, -1);
+
+        // gl.xml doesn't include qualifiers such as const in the type, so the
+        // type is everything up to the name.
+        int type_count = (int)content_of(ctx, next_param)->length - 1;
+        param->type = inner_text(ctx, next_param, type_count);
+        if (param->type.length > 0 &&
+            param->type.start[param->type.length - 1] == ' ') {
+            param->type.length--;
+        }
+
+        xml_Token *param_name =
+            find_next(ctx, next_param, ctx->atoms.name, NULL);
+        param->name = param_name ? inner_text(ctx, param_name, -1)
+                                 : (StringView){ .start = "", .length = 0 };
+    }
+    command->param_count = ctx->registry->param_count - command->first_param;
+
+    return true;
+}
+
+static void add_feature(BuildContext *ctx, xml_Token *element) {
+    Feature *feature = PUSH(ctx, features, feature_count, features_capacity);
+    *feature = (Feature){
+        .api = attribute(element, ctx->atoms.api),
+        .name = attribute(element, ctx->atoms.name),
+        .first_block = ctx->registry->block_count,
+        .element = element,
+    };
+
+    xml_ContentList *content = content_of(ctx, element);
+    for (size_t i = 0; i < content->length; i++) {
+        xml_Token *child = &content->tokens[i];
+        bool remove = is_element(child, ctx->atoms.remove);
+        if (!remove && !is_element(child, ctx->atoms.require)) {
+            continue;
+        }
+
+        FeatureBlock *block = PUSH(ctx, blocks, block_count, blocks_capacity);
+        *block = (FeatureBlock){
+            .remove = remove,
+            .profile = attribute(child, ctx->atoms.profile),
+            .first_definition = ctx->registry->definition_count,
+            .element = child,
+        };
+
+        xml_ContentList *definitions = content_of(ctx, child);
+        for (size_t j = 0; j < definitions->length; j++) {
+            xml_Token *def = &definitions->tokens[j];
+            DefinitionType type;
+
+            if (is_element(def, ctx->atoms.enum_))
+                type = DEF_ENUM;
+            else if (is_element(def, ctx->atoms.command))
+                type = DEF_CMD;
+            else
+                continue;
+
+            Definition *definition = PUSH(ctx, definitions, definition_count,
+                                          definitions_capacity);
+            definition->type = type;
+            definition->name = attribute(def, ctx->atoms.name);
+        }
+
+        // `block` may have moved while the definitions were added.
+        block = &ctx->registry->blocks[ctx->registry->block_count - 1];
+        block->definition_count =
+            ctx->registry->definition_count - block->first_definition;
+    }
+
+    feature = &ctx->registry->features[ctx->registry->feature_count - 1];
+    feature->block_count = ctx->registry->block_count - feature->first_block;
+}
+
+typedef StringView (*NameOf)(const Registry *registry, size_t index);
+
+static StringView command_name(const Registry *registry, size_t index) {
+    return registry->commands[index].name;
+}
+
+static StringView enum_name(const Registry *registry, size_t index) {
+    return registry->enums[index].name;
+}
+
+// Returns the slot that holds `name`, or the empty slot where it belongs.
+static size_t find_slot(const Registry *registry, const NameIndex *index,
+                        NameOf name_of, StringView name) {
+    size_t mask = index->slot_count - 1;
+    size_t slot = sv_hash(name) & mask;
+
+    while (index->slots[slot] != 0 &&
+           !sv_equal(name_of(registry, index->slots[slot] - 1), name)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void init_index(NameIndex *index, size_t count) {
+    // Keep the table at most half full.
+    index->slot_count = 16;
+    while (index->slot_count < 2 * count) {
+        index->slot_count *= 2;
+    }
+    index->slots = mem_calloc(index->slot_count, sizeof(*index->slots));
+}
+
+static void build_indices(Registry *registry) {
+    init_index(&registry->command_index, registry->command_count);
+    for (size_t i = 0; i < registry->command_count; i++) {
+        size_t slot = find_slot(registry, &registry->command_index,
+                                command_name, registry->commands[i].name);
+        // The first command of a name wins.
+        if (registry->command_index.slots[slot] == 0) {
+            registry->command_index.slots[slot] = (uint32_t)i + 1;
+        }
+    }
+
+    init_index(&registry->enum_index, registry->enum_count);
+    for (size_t i = 0; i < registry->enum_count; i++) {
+        Enum *_enum = &registry->enums[i];
+        size_t slot = find_slot(registry, &registry->enum_index, enum_name,
+                                _enum->name);
+        if (registry->enum_index.slots[slot] == 0) {
+            registry->enum_index.slots[slot] = (uint32_t)i + 1;
+            continue;
+        }
+
+        // Duplicates are rare, so walking the chain is cheap enough.
+        Enum *last = &registry->enums[registry->enum_index.slots[slot] - 1];
+        while (last->next != NULL) {
+            last = (Enum *)last->next;
+        }
+        last->next = _enum;
+    }
+}
+
+const Command *registry_find_command(const Registry *registry,
+                                     StringView name) {
+    const NameIndex *index = &registry->command_index;
+    uint32_t entry =
+        index->slots[find_slot(registry, index, command_name, name)];
+    return entry != 0 ? &registry->commands[entry - 1] : NULL;
+}
+
+const Enum *registry_find_enum(const Registry *registry, StringView name) {
+    const NameIndex *index = &registry->enum_index;
+    uint32_t entry = index->slots[find_slot(registry, index, enum_name, name)];
+    return entry != 0 ? &registry->enums[entry - 1] : NULL;
+}
+
+bool registry_build(xml_Document *doc, Registry *registry) {
+    *registry = (Registry){ .root = &doc->root };
+
+    BuildContext ctx = {
+        .doc = doc,
+        .registry = registry,
+        .scratch = sb_new_buffer(),
+    };
+#define X(field, name) ctx.atoms.field = xml_atom(doc, name);
+    ATOM_NAMES
+#undef X
+
+    bool success = true;
+    xml_Token *types = NULL;
+    xml_Token *commands = NULL;
+
+    xml_ContentList *content = content_of(&ctx, &doc->root);
+    for (size_t i = 0; i < content->length && success; i++) {
+        xml_Token *child = &content->tokens[i];
+
+        if (is_element(child, ctx.atoms.types)) {
+            if (types == NULL) {
+                types = child;
+                add_types(&ctx, types);
+            }
+        } else if (is_element(child, ctx.atoms.enums)) {
+            add_enums(&ctx, child);
+        } else if (is_element(child, ctx.atoms.commands)) {
+            if (commands != NULL) {
+                continue;
+            }
+            commands = child;
+
+            size_t command_index = 0;
+            xml_Token *command = NULL;
+            while (success && (command = find_next(&ctx, commands,
+                                                   ctx.atoms.command,
+                                                   &command_index))) {
+                success = add_command(&ctx, command);
+            }
+        } else if (is_element(child, ctx.atoms.feature)) {
+            add_feature(&ctx, child);
+        }
+    }
+
+    if (success && (types == NULL || commands == NULL)) {
+        fprintf(stderr, "Generation error: expected <types> and <commands>!\n");
+        success = false;
+    }
+
+    registry->types_element = types;
+    registry->commands_element = commands;
+    sb_free(ctx.scratch);
+
+    if (!success) {
+        registry_free(registry);
+        return false;
+    }
+
+    build_indices(registry);
+    return true;
+}
+
+void registry_free(Registry *registry) {
+    mem_free(registry->types);
+    mem_free(registry->enums);
+    mem_free(registry->commands);
+    mem_free(registry->params);
+    mem_free(registry->features);
+    mem_free(registry->blocks);
+    mem_free(registry->definitions);
+    mem_free(registry->command_index.slots);
+    mem_free(registry->enum_index.slots);
+    arena_free(&registry->arena);
+    *registry = (Registry){ 0 };
+}
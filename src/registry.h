@@ -0,0 +1,130 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "arena.h"
+#include "string_view.h"
+#include "xml.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The parts of gl.xml that code generation reads, extracted in a single pass
+// over the document into flat arrays. Text that had entities or nested
+// elements in it is decoded into `arena`; everything else points straight into
+// the source buffer, which must outlive the registry.
+//
+// Every entry also remembers the element it came from so that a pruned copy
+// of the document can be written. Those pointers are only valid while the
+// document is alive; nothing else in the registry refers to it.
+
+typedef struct {
+    // The whole parameter, as written in a prototype: "const GLfloat *v".
+    StringView declaration;
+    // The parameter without its name and trailing space: "const GLfloat *".
+    StringView type;
+    StringView name;
+} Param;
+
+typedef struct {
+    StringView name;
+    StringView return_type;
+    // The prototype starts with the text "void ", so wrappers don't return.
+    bool returns_void;
+    // The parameters are `params[first_param..first_param + param_count]`.
+    size_t first_param;
+    size_t param_count;
+    const xml_Token *element;
+} Command;
+
+typedef struct _Enum {
+    StringView name;
+    StringView value;
+    const xml_Token *element;
+    // The <enums> block the enum is in.
+    const xml_Token *block;
+    // The next enum with the same name, in document order, or NULL.
+    const struct _Enum *next;
+} Enum;
+
+typedef struct {
+    StringView text;
+} Type;
+
+typedef enum {
+    DEF_ENUM,
+    DEF_CMD,
+} DefinitionType;
+
+typedef struct {
+    DefinitionType type;
+    // `start` is NULL if the element has no `name` attribute.
+    StringView name;
+} Definition;
+
+// A <require> or <remove> block of a <feature>.
+typedef struct {
+    bool remove;
+    // `start` is NULL if the block applies to every profile.
+    StringView profile;
+    size_t first_definition;
+    size_t definition_count;
+    const xml_Token *element;
+} FeatureBlock;
+
+typedef struct {
+    // `start` is NULL if the attribute is missing.
+    StringView api;
+    StringView name;
+    size_t first_block;
+    size_t block_count;
+    const xml_Token *element;
+} Feature;
+
+// An open-addressing hash table from names to entries of one of the registry's
+// arrays. Each slot holds an index plus one, so 0 marks an empty slot.
+typedef struct {
+    uint32_t *slots;
+    size_t slot_count;
+} NameIndex;
+
+typedef struct {
+    // The <type>s of the first <types> block.
+    Type *types;
+    size_t type_count;
+    // Every <enum> of every <enums> block, in document order.
+    Enum *enums;
+    size_t enum_count;
+    // The <command>s of the first <commands> block.
+    Command *commands;
+    size_t command_count;
+    Param *params;
+    size_t param_count;
+    // Every <feature>, in document order.
+    Feature *features;
+    size_t feature_count;
+    FeatureBlock *blocks;
+    size_t block_count;
+    Definition *definitions;
+    size_t definition_count;
+
+    NameIndex command_index;
+    NameIndex enum_index;
+
+    const xml_Token *root;
+    const xml_Token *types_element;
+    const xml_Token *commands_element;
+
+    Arena arena;
+} Registry;
+
+// Fails if the document has no <types> or <commands> block.
+bool registry_build(xml_Document *doc, Registry *registry);
+void registry_free(Registry *registry);
+
+// Return NULL if there is no command or enum called `name`. If several have
+// that name, the first one is returned; the other enums follow through `next`.
+const Command *registry_find_command(const Registry *registry,
+                                     StringView name);
+const Enum *registry_find_enum(const Registry *registry, StringView name);
+
+#endif
@@ -0,0 +1,174 @@
+#include "stats.h"
+#include "mem.h"
+#include "thread.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+static const char *const phase_names[] = {
+#define X(phase, name) #name,
+    STATS_PHASES
+#undef X
+};
+
+double stats_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+// Targets are generated on several threads, so the counters are shared.
+typedef struct {
+    bool counting;
+    Mutex mutex;
+    uint64_t allocations;
+    uint64_t bytes;
+} AllocationCounter;
+
+static AllocationCounter counter;
+
+static void count_allocation(size_t size) {
+    mutex_lock(&counter.mutex);
+    counter.allocations++;
+    counter.bytes += size;
+    mutex_unlock(&counter.mutex);
+}
+
+static void *counting_malloc(void *user, size_t size) {
+    (void)user;
+    count_allocation(size);
+    return malloc(size);
+}
+
+static void *counting_calloc(void *user, size_t count, size_t size) {
+    (void)user;
+    count_allocation(count * size);
+    return calloc(count, size);
+}
+
+static void *counting_realloc(void *user, void *ptr, size_t size) {
+    (void)user;
+    count_allocation(size);
+    return realloc(ptr, size);
+}
+
+static void counting_free(void *user, void *ptr) {
+    (void)user;
+    free(ptr);
+}
+
+void stats_count_allocations(void) {
+    mutex_init(&counter.mutex);
+    counter.counting = true;
+
+    MemHooks hooks = {
+        .malloc = counting_malloc,
+        .calloc = counting_calloc,
+        .realloc = counting_realloc,
+        .free = counting_free,
+    };
+    mem_set_hooks(&hooks);
+}
+
+void stats_add(Stats *stats, const Stats *other) {
+    for (size_t i = 0; i < STATS_PHASE_COUNT; i++) {
+        stats->seconds[i] += other->seconds[i];
+    }
+    stats->targets += other->targets;
+    stats->requirements += other->requirements;
+    stats->commands += other->commands;
+    stats->enums += other->enums;
+}
+
+static uint64_t peak_rss(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;
+#else
+    // Linux and the BSDs report kilobytes.
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+void stats_finish(Stats *stats) {
+    if (counter.counting) {
+        mutex_lock(&counter.mutex);
+        stats->allocations = counter.allocations;
+        stats->allocated_bytes = counter.bytes;
+        mutex_unlock(&counter.mutex);
+    }
+
+    stats->peak_rss_bytes = peak_rss();
+}
+
+void stats_print(const Stats *stats, FILE *fp) {
+    fprintf(fp, "%-14s %10.3f ms\n", "total", stats->total_seconds * 1e3);
+    for (size_t i = 0; i < STATS_PHASE_COUNT; i++) {
+        fprintf(fp, "  %-12s %10.3f ms\n", phase_names[i],
+                stats->seconds[i] * 1e3);
+    }
+    fprintf(fp, "%-14s %10zu\n", "targets", stats->targets);
+    fprintf(fp, "%-14s %10zu\n", "requirements", stats->requirements);
+    fprintf(fp, "%-14s %10zu\n", "commands", stats->commands);
+    fprintf(fp, "%-14s %10zu\n", "enums", stats->enums);
+    fprintf(fp, "%-14s %10llu (%llu bytes)\n", "allocations",
+            (unsigned long long)stats->allocations,
+            (unsigned long long)stats->allocated_bytes);
+    fprintf(fp, "%-14s %10llu bytes\n", "peak RSS",
+            (unsigned long long)stats->peak_rss_bytes);
+}
+
+bool stats_write_json(const Stats *stats, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "error: couldn't open `%s`!\n", path);
+        return false;
+    }
+
+    fprintf(fp, "{\n  \"seconds\": {\n    \"total\": %.6f",
+            stats->total_seconds);
+    for (size_t i = 0; i < STATS_PHASE_COUNT; i++) {
+        fprintf(fp, ",\n    \"%s\": %.6f", phase_names[i], stats->seconds[i]);
+    }
+    fprintf(fp, "\n  },\n");
+    fprintf(fp, "  \"targets\": %zu,\n", stats->targets);
+    fprintf(fp, "  \"requirements\": %zu,\n", stats->requirements);
+    fprintf(fp, "  \"commands\": %zu,\n", stats->commands);
+    fprintf(fp, "  \"enums\": %zu,\n", stats->enums);
+    fprintf(fp, "  \"allocations\": %llu,\n",
+            (unsigned long long)stats->allocations);
+    fprintf(fp, "  \"allocated_bytes\": %llu,\n",
+            (unsigned long long)stats->allocated_bytes);
+    fprintf(fp, "  \"peak_rss_bytes\": %llu\n}\n",
+            (unsigned long long)stats->peak_rss_bytes);
+
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "error: couldn't write `%s`!\n", path);
+        return false;
+    }
+    return true;
+}
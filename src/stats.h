@@ -0,0 +1,61 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_PHASES                                                           \
+    X(STATS_READ, read)                                                        \
+    X(STATS_STAMP, stamp)                                                      \
+    X(STATS_PARSE, parse)                                                      \
+    X(STATS_REGISTRY, registry)                                                \
+    X(STATS_TYPES, types)                                                      \
+    X(STATS_FEATURESET, featureset)                                            \
+    X(STATS_DEFINITIONS, definitions)                                          \
+    X(STATS_COMMANDS, commands)                                                \
+    X(STATS_TEMPLATES, templates)                                              \
+    X(STATS_WRITE, write)
+
+typedef enum {
+#define X(phase, name) phase,
+    STATS_PHASES
+#undef X
+        STATS_PHASE_COUNT,
+} StatsPhase;
+
+// What one run of the generator spent and produced. The phases from `types`
+// on run once per target, possibly on several threads at once, and are summed
+// over the targets, so together they can exceed `total_seconds`.
+typedef struct {
+    double total_seconds;
+    double seconds[STATS_PHASE_COUNT];
+
+    size_t targets;
+    size_t requirements;
+    size_t commands;
+    size_t enums;
+
+    // Only counted after stats_count_allocations.
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    // 0 if the platform can't tell.
+    uint64_t peak_rss_bytes;
+} Stats;
+
+// Seconds since an arbitrary point, from a monotonic clock.
+double stats_now(void);
+
+// Counts every allocation made through mem.h from now on.
+void stats_count_allocations(void);
+
+// Adds the per-target phases and counts of `other` to `stats`.
+void stats_add(Stats *stats, const Stats *other);
+// Takes the allocation counts and peak RSS of the run so far.
+void stats_finish(Stats *stats);
+
+void stats_print(const Stats *stats, FILE *fp);
+bool stats_write_json(const Stats *stats, const char *path);
+
+#endif
@@ -1,23 +1,37 @@
 #include "string_buffer.h"
-#include <stdlib.h>
+#include "mem.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 
-StringBuffer sb_new_buffer(void) {
+#define SB_START_CAPACITY 32
+
+StringBuffer sb_new_buffer(void) { return sb_with_capacity(0); }
+
+StringBuffer sb_with_capacity(size_t length) {
     StringBuffer sb = { 0 };
-    sb.capacity = 32;
-    sb.ptr = calloc(sb.capacity, sizeof(char));
+    sb.capacity = length + 1 < SB_START_CAPACITY ? SB_START_CAPACITY
+                                                 : length + 1;
+    sb.ptr = mem_calloc(sb.capacity, sizeof(char));
     return sb;
 }
 
-void sb_free(StringBuffer sb) { free(sb.ptr); }
+void sb_free(StringBuffer sb) { mem_free(sb.ptr); }
+
+void sb_reserve(StringBuffer *sb, size_t length) {
+    size_t needed = sb->length + length + 1;
+    if (needed <= sb->capacity) {
+        return;
+    }
 
-static void sb_grow_buffer(StringBuffer *sb) {
-    sb->capacity *= 2;
-    sb->ptr = realloc(sb->ptr, sb->capacity);
+    // At least double, so that appending piece by piece stays linear.
+    sb->capacity = needed > 2 * sb->capacity ? needed : 2 * sb->capacity;
+    sb->ptr = mem_realloc(sb->ptr, sb->capacity);
 }
 
 void sb_putc(int c, StringBuffer *sb) {
     if (sb->length + 1 >= sb->capacity) {
-        sb_grow_buffer(sb);
+        sb_reserve(sb, 1);
     }
 
     sb->ptr[sb->length + 0] = c;
@@ -26,14 +40,38 @@ void sb_putc(int c, StringBuffer *sb) {
 }
 
 void sb_puts(const char *str, StringBuffer *sb) {
-    // TODO: optimize this to potentially realloc once and memcpy the string!
-    for (size_t i = 0; str[i] != '\0'; i++) {
-        sb_putc(str[i], sb);
-    }
+    sb_putsn(sb, str, strlen(str));
 }
 
 void sb_putsn(StringBuffer *sb, const char *str, size_t length) {
-    for (size_t i = 0; i < length; i++) {
-        sb_putc(str[i], sb);
+    sb_reserve(sb, length);
+    memcpy(&sb->ptr[sb->length], str, length);
+    sb->length += length;
+    sb->ptr[sb->length] = '\0';
+}
+
+void sb_put_sv(StringBuffer *sb, StringView sv) {
+    sb_putsn(sb, sv.start, sv.length);
+}
+
+void sb_printf(StringBuffer *sb, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t available = sb->capacity - sb->length;
+    int length = vsnprintf(&sb->ptr[sb->length], available, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        sb->ptr[sb->length] = '\0';
+        return;
+    }
+
+    // It didn't fit, so make room and format it again.
+    if ((size_t)length >= available) {
+        sb_reserve(sb, (size_t)length);
+        va_start(args, format);
+        vsnprintf(&sb->ptr[sb->length], (size_t)length + 1, format, args);
+        va_end(args);
     }
+    sb->length += (size_t)length;
 }
@@ -1,8 +1,10 @@
 #ifndef STRING_BUFFER_H
 #define STRING_BUFFER_H
 
+#include "string_view.h"
 #include <stddef.h>
 
+// A growable, NUL-terminated string. `capacity` counts the terminator.
 typedef struct {
     char *ptr;
     size_t length;
@@ -10,10 +12,22 @@ typedef struct {
 } StringBuffer;
 
 StringBuffer sb_new_buffer(void);
+// Starts out with room for `length` characters, so filling a buffer of known
+// size never reallocates.
+StringBuffer sb_with_capacity(size_t length);
 void sb_free(StringBuffer sb);
 
+// Makes room for `length` more characters.
+void sb_reserve(StringBuffer *sb, size_t length);
+
 void sb_putc(int c, StringBuffer *sb);
 void sb_puts(const char *str, StringBuffer *sb);
 void sb_putsn(StringBuffer *sb, const char *str, size_t length);
+void sb_put_sv(StringBuffer *sb, StringView sv);
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+void sb_printf(StringBuffer *sb, const char *format, ...);
 
 #endif
@@ -49,6 +49,15 @@ bool sv_equal_cstr(StringView a, const char *b) {
     return true;
 }
 
+uint32_t sv_hash(StringView sv) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sv.length; i++) {
+        hash ^= (unsigned char)sv.start[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 bool convenient_starts_with(const char *str, const char *with) {
     for (size_t i = 0; with[i] != '\0'; i++) {
         if (str[i] == '\0' || str[i] != with[i]) {
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
     const char *start;
@@ -13,6 +14,8 @@ bool cstr_starts_with_sv(const char *str, StringView with);
 bool sv_starts_with_cstr(StringView str, const char *with);
 bool sv_equal(StringView a, StringView b);
 bool sv_equal_cstr(StringView a, const char *b);
+// FNV-1a
+uint32_t sv_hash(StringView sv);
 
 bool convenient_starts_with(const char *str, const char *with);
 size_t convenient_strlen(const char *str);
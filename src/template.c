@@ -1,65 +1,160 @@
 #include "template.h"
-#include "string_buffer.h"
+#include "mem.h"
 #include "string_view.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 
-#define VARIABLE_START_COUNT 8
+#define SEGMENT_START_COUNT 16
 
-void template_define(Template *t, const char *name, StringView value) {
-    if (t->variables == NULL) {
-        t->variable_capacity = VARIABLE_START_COUNT;
-        t->variables = calloc(t->variable_capacity, sizeof(*t->variables));
+// The variable names, hashed. Each slot holds an index into `names` plus one,
+// so 0 marks an empty slot.
+typedef struct {
+    const StringView *names;
+    uint32_t *slots;
+    size_t slot_count;
+} NameTable;
+
+// Returns the slot that holds `name`, or the empty slot where it belongs.
+static size_t find_name_slot(const NameTable *table, StringView name) {
+    size_t mask = table->slot_count - 1;
+    size_t slot = sv_hash(name) & mask;
+
+    while (table->slots[slot] != 0 &&
+           !sv_equal(table->names[table->slots[slot] - 1], name)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void put_segment(Template *template, size_t variable,
+                        StringView literal) {
+    if (variable == TEMPLATE_LITERAL && literal.length == 0) {
+        return;
     }
 
-    if (t->variable_count >= t->variable_capacity) {
-        t->variable_capacity *= 2;
-        t->variables =
-            realloc(t->variables, t->variable_capacity * sizeof(*t->variables));
+    if (template->segment_count >= template->segment_capacity) {
+        template->segment_capacity = template->segment_capacity == 0
+                                         ? SEGMENT_START_COUNT
+                                         : template->segment_capacity * 2;
+        template->segments = mem_realloc(
+            template->segments,
+            template->segment_capacity * sizeof(*template->segments));
     }
 
-    t->variables[t->variable_count++] = (TemplateVariable){
-        .name = name,
-        .value = value,
+    template->segments[template->segment_count++] = (TemplateSegment){
+        .variable = variable,
+        .literal = literal,
     };
 }
 
-StringBuffer template_build(Template *template, const char *source) {
-    StringBuffer sb = sb_new_buffer();
+static void put_literal(Template *template, const char *start,
+                        const char *end) {
+    StringView literal = { .start = start, .length = (size_t)(end - start) };
+    put_segment(template, TEMPLATE_LITERAL, literal);
+}
 
-    char ch;
-    while ((ch = (source++)[0]) != '\0') {
-        if (ch != '%') {
-            sb_putc(ch, &sb);
-            continue;
-        }
+void template_compile(char *source, const char *const *names,
+                      size_t name_count, Template *template) {
+    *template = (Template){
+        .source = source,
+        .variable_count = name_count,
+    };
 
-        bool found = false;
-        for (size_t i = 0; i < template->variable_count; i++) {
-            TemplateVariable var = template->variables[i];
-            size_t var_name_len = convenient_strlen(var.name);
+    StringView *name_views = mem_calloc(name_count + 1, sizeof(*name_views));
+    NameTable table = { .names = name_views, .slot_count = 8 };
+    while (table.slot_count < 2 * name_count) {
+        table.slot_count *= 2;
+    }
+    table.slots = mem_calloc(table.slot_count, sizeof(*table.slots));
+    for (size_t i = 0; i < name_count; i++) {
+        name_views[i] = (StringView){
+            .start = names[i],
+            .length = convenient_strlen(names[i]),
+        };
+        size_t slot = find_name_slot(&table, name_views[i]);
+        if (table.slots[slot] == 0) {
+            table.slots[slot] = (uint32_t)i + 1;
+        }
+    }
 
-            if (!convenient_starts_with(source, var.name)) {
-                continue;
-            }
+    const char *literal = source;
+    const char *ch = source;
+    while (*ch != '\0') {
+        if (*ch != '%') {
+            ch++;
+            continue;
+        }
 
-            if (source[var_name_len] != '%') {
-                continue;
-            }
+        put_literal(template, literal, ch);
+        ch++;
 
-            source = &source[var_name_len + 1];
-            sb_putsn(&sb, var.value.start, var.value.length);
-            found = true;
-            break;
+        // The name runs up to the next `%`.
+        const char *end = ch;
+        while (*end != '\0' && *end != '%') {
+            end++;
         }
 
-        if (!found) {
+        StringView name = { .start = ch, .length = (size_t)(end - ch) };
+        size_t slot = find_name_slot(&table, name);
+        if (*end == '%' && table.slots[slot] != 0) {
+            StringView none = { .start = NULL, .length = 0 };
+            put_segment(template, table.slots[slot] - 1, none);
+            ch = end + 1;
+        } else {
             fprintf(stderr, "error: unknown template variable\n");
         }
+        literal = ch;
     }
+    put_literal(template, literal, ch);
 
-    return sb;
+    mem_free(table.slots);
+    mem_free(name_views);
 }
 
-void template_free(Template *template) { free(template->variables); }
+static void put_slice(TemplateOutput *output, StringView slice) {
+    if (slice.length == 0) {
+        return;
+    }
+
+    if (output->slice_count >= output->slice_capacity) {
+        output->slice_capacity =
+            output->slice_capacity == 0 ? 16 : output->slice_capacity * 2;
+        output->slices = mem_realloc(output->slices, output->slice_capacity *
+                                                     sizeof(*output->slices));
+    }
+
+    output->slices[output->slice_count++] = slice;
+    output->length += slice.length;
+}
+
+TemplateOutput template_build(const Template *template,
+                              const StringView *values) {
+    TemplateOutput output = { 0 };
+    output.slice_capacity = template->segment_count;
+    output.slices =
+        mem_calloc(output.slice_capacity + 1, sizeof(*output.slices));
+
+    for (size_t i = 0; i < template->segment_count; i++) {
+        const TemplateSegment *segment = &template->segments[i];
+        if (segment->variable == TEMPLATE_LITERAL) {
+            put_slice(&output, segment->literal);
+        } else {
+            put_slice(&output, values[segment->variable]);
+        }
+    }
+
+    return output;
+}
+
+void template_free(Template *template) {
+    mem_free(template->source);
+    mem_free(template->segments);
+    *template = (Template){ 0 };
+}
+
+void template_output_free(TemplateOutput *output) {
+    mem_free(output->slices);
+    *output = (TemplateOutput){ 0 };
+}
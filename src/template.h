@@ -1,23 +1,48 @@
 #ifndef TEMPLATE_H
 #define TEMPLATE_H
 
-#include "string_buffer.h"
 #include "string_view.h"
 #include <stddef.h>
 
+// Marks a segment that is a span of the template itself.
+#define TEMPLATE_LITERAL ((size_t)-1)
+
 typedef struct {
-    const char *name;
-    StringView value;
-} TemplateVariable;
+    // The variable whose value goes here, or TEMPLATE_LITERAL.
+    size_t variable;
+    StringView literal;
+} TemplateSegment;
 
+// A template split up front into literal spans and variable slots, so that it
+// can be built any number of times without scanning it again. Variables are
+// written `%NAME%` and refer to the `names` the template was compiled with by
+// index.
 typedef struct {
-    TemplateVariable *variables;
+    char *source;
+    TemplateSegment *segments;
+    size_t segment_count;
+    size_t segment_capacity;
     size_t variable_count;
-    size_t variable_capacity;
 } Template;
 
-void template_define(Template *template, const char *name, StringView value);
-StringBuffer template_build(Template *template, const char *source);
+// The built text, as slices of the template source and of the variables'
+// values, in order. Nothing is copied, so both have to outlive it.
+typedef struct {
+    StringView *slices;
+    size_t slice_count;
+    size_t slice_capacity;
+    // The total length of the slices.
+    size_t length;
+} TemplateOutput;
+
+// Takes over `source`, which has to be allocated with mem_malloc.
+void template_compile(char *source, const char *const *names,
+                      size_t name_count, Template *template);
+// `values` holds one value for each of the names the template was compiled
+// with.
+TemplateOutput template_build(const Template *template,
+                              const StringView *values);
 void template_free(Template *template);
+void template_output_free(TemplateOutput *output);
 
 #endif
@@ -0,0 +1,66 @@
+#include "thread.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI trampoline(LPVOID arg) {
+    Thread *thread = arg;
+    thread->proc(thread->arg);
+    return 0;
+}
+
+bool thread_start(Thread *thread, ThreadProc proc, void *arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, trampoline, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+void thread_join(Thread *thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+size_t thread_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+void mutex_init(Mutex *mutex) { InitializeSRWLock(&mutex->lock); }
+
+void mutex_destroy(Mutex *mutex) { (void)mutex; }
+
+void mutex_lock(Mutex *mutex) { AcquireSRWLockExclusive(&mutex->lock); }
+
+void mutex_unlock(Mutex *mutex) { ReleaseSRWLockExclusive(&mutex->lock); }
+#else
+static void *trampoline(void *arg) {
+    Thread *thread = arg;
+    thread->proc(thread->arg);
+    return NULL;
+}
+
+bool thread_start(Thread *thread, ThreadProc proc, void *arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, trampoline, thread) == 0;
+}
+
+void thread_join(Thread *thread) { pthread_join(thread->handle, NULL); }
+
+size_t thread_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+void mutex_init(Mutex *mutex) { pthread_mutex_init(&mutex->lock, NULL); }
+
+void mutex_destroy(Mutex *mutex) { pthread_mutex_destroy(&mutex->lock); }
+
+void mutex_lock(Mutex *mutex) { pthread_mutex_lock(&mutex->lock); }
+
+void mutex_unlock(Mutex *mutex) { pthread_mutex_unlock(&mutex->lock); }
+#endif
@@ -0,0 +1,46 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+typedef void (*ThreadProc)(void *arg);
+
+// A thin wrapper around the platform's threads. The struct must stay at the
+// same address until the thread has been joined.
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    ThreadProc proc;
+    void *arg;
+} Thread;
+
+bool thread_start(Thread *thread, ThreadProc proc, void *arg);
+void thread_join(Thread *thread);
+
+// The number of processors available, at least 1.
+size_t thread_cpu_count(void);
+
+typedef struct {
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} Mutex;
+
+void mutex_init(Mutex *mutex);
+void mutex_destroy(Mutex *mutex);
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+
+#endif
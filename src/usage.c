@@ -0,0 +1,144 @@
+#include "usage.h"
+#include "mem.h"
+#include "xml.h"
+#include "xml_compact.h"
+#include <string.h>
+
+#define USAGE_START_SLOTS 256
+
+static bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool is_identifier_char(char c) {
+    return is_identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+// Returns the slot that holds `name`, or the empty slot where it belongs.
+static size_t find_slot(const Usage *usage, StringView name) {
+    size_t mask = usage->slot_count - 1;
+    size_t slot = sv_hash(name) & mask;
+
+    while (usage->slots[slot].start != NULL &&
+           !sv_equal(usage->slots[slot], name)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void grow_slots(Usage *usage) {
+    StringView *old_slots = usage->slots;
+    size_t old_slot_count = usage->slot_count;
+
+    usage->slot_count =
+        old_slot_count == 0 ? USAGE_START_SLOTS : old_slot_count * 2;
+    usage->slots = mem_calloc(usage->slot_count, sizeof(*usage->slots));
+    for (size_t i = 0; i < old_slot_count; i++) {
+        if (old_slots[i].start != NULL) {
+            usage->slots[find_slot(usage, old_slots[i])] = old_slots[i];
+        }
+    }
+
+    mem_free(old_slots);
+}
+
+static void add_name(Usage *usage, StringView name) {
+    size_t slot = find_slot(usage, name);
+    if (usage->slots[slot].start != NULL) {
+        return;
+    }
+
+    usage->slots[slot] = name;
+    usage->count++;
+
+    // Keep the set at most half full.
+    if (2 * usage->count >= usage->slot_count) {
+        grow_slots(usage);
+    }
+}
+
+static void scan(Usage *usage, const char *text, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        if (!is_identifier_start(text[i])) {
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < length && is_identifier_char(text[i])) {
+            i++;
+        }
+        while (start < i && text[start] == '_') {
+            start++;
+        }
+
+        StringView name = { .start = &text[start], .length = i - start };
+        if (sv_starts_with_cstr(name, "gl") && name.length > 2) {
+            add_name(usage, name);
+        } else if (sv_starts_with_cstr(name, "GL_") && name.length > 3) {
+            add_name(usage, name);
+        }
+    }
+}
+
+static bool load_file(Usage *usage, const char *path) {
+    char *text = xml_read_file(path);
+    if (text == NULL) {
+        return false;
+    }
+
+    usage->files = mem_realloc(usage->files, (usage->file_count + 1) *
+                                             sizeof(*usage->files));
+    usage->files[usage->file_count++] = text;
+
+    size_t length = strlen(text);
+    usage->hash = xml_compact_hash(text, length) ^
+                  (usage->hash * 1099511628211ull);
+    scan(usage, text, length);
+    return true;
+}
+
+bool usage_load(const char *paths, Usage *usage) {
+    *usage = (Usage){ 0 };
+    grow_slots(usage);
+
+    bool success = true;
+    const char *cursor = paths;
+    while (success) {
+        const char *end = strchr(cursor, ',');
+        size_t length = end ? (size_t)(end - cursor) : strlen(cursor);
+
+        if (length > 0) {
+            char *path = mem_malloc(length + 1);
+            memcpy(path, cursor, length);
+            path[length] = '\0';
+            success = load_file(usage, path);
+            mem_free(path);
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        cursor = end + 1;
+    }
+
+    if (!success) {
+        usage_free(usage);
+    }
+    return success;
+}
+
+bool usage_contains(const Usage *usage, StringView name) {
+    return usage->slots[find_slot(usage, name)].start != NULL;
+}
+
+void usage_free(Usage *usage) {
+    for (size_t i = 0; i < usage->file_count; i++) {
+        mem_free(usage->files[i]);
+    }
+    mem_free(usage->files);
+    mem_free(usage->slots);
+    *usage = (Usage){ 0 };
+}
@@ -0,0 +1,32 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include "string_view.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The GL names an application refers to, gathered from its sources or from
+// symbol lists such as the output of `nm`. Every identifier starting with `gl`
+// or `GL_` is taken, after stripping leading underscores, so both
+// `glClearColor` and a mangled `_glClearColor` count. Names point into the
+// loaded files, which live as long as the set.
+typedef struct {
+    char **files;
+    size_t file_count;
+
+    // An open-addressing hash set; empty slots have a NULL `start`.
+    StringView *slots;
+    size_t slot_count;
+    size_t count;
+
+    // A hash over the contents of every file.
+    uint64_t hash;
+} Usage;
+
+// `paths` is a comma-separated list of files.
+bool usage_load(const char *paths, Usage *usage);
+bool usage_contains(const Usage *usage, StringView name);
+void usage_free(Usage *usage);
+
+#endif
@@ -1,75 +1,308 @@
 #include "xml.h"
+#include "mem.h"
+#include "thread.h"
+#include "xml_compact.h"
 #include <assert.h>
-#include <ctype.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Define XML_NO_SIMD to scan with memchr only.
+#if !defined(XML_NO_SIMD) && defined(__AVX2__)
+#define XML_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(XML_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define XML_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(XML_SIMD_AVX2) || defined(XML_SIMD_SSE2)) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #ifdef _WIN32
 #define _CRT_SECURE_NO_WARNINGS
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
-#define DYNARRAY_START_CAP 8
+#define DYNARRAY_START_CAP 64
 #define DYNARRAY_GROWTH 2
 
+// Children and attributes are collected on these scratch stacks while an
+// element is being parsed and are copied into the arena, at their exact size,
+// once the element is closed. The stacks are reused for the whole parse.
+typedef struct {
+    xml_Token *tokens;
+    size_t length;
+    size_t capacity;
+} TokenStack;
+
+typedef struct {
+    xml_Attrib *attribs;
+    size_t length;
+    size_t capacity;
+} AttribStack;
+
 typedef struct {
     const char *src;
+    size_t length;
     size_t cursor;
+    Arena *arena;
+    xml_AtomTable *atoms;
+    bool lazy;
+    TokenStack token_stack;
+    AttribStack attrib_stack;
     jmp_buf on_error;
+
+    // Parser threads intern into `atoms` as a private cache and map its atoms
+    // to those of the document's table, which is shared by all of them.
+    xml_AtomTable *shared_atoms;
+    Mutex *shared_atoms_lock;
+    xml_Atom *atom_map;
+    size_t atom_map_capacity;
 } ParseContext;
 
-static void add_content(xml_ContentList *content_list, xml_Token content) {
-    if (content_list->tokens == NULL) {
-        content_list->capacity = DYNARRAY_START_CAP;
-        content_list->tokens = calloc(content_list->capacity, sizeof(content));
+static void push_token(ParseContext *ctx, xml_Token token) {
+    TokenStack *stack = &ctx->token_stack;
+    if (stack->length >= stack->capacity) {
+        stack->capacity = stack->capacity == 0
+                              ? DYNARRAY_START_CAP
+                              : stack->capacity * DYNARRAY_GROWTH;
+        stack->tokens = mem_realloc(stack->tokens,
+                                    stack->capacity * sizeof(*stack->tokens));
+    }
+
+    stack->tokens[stack->length++] = token;
+}
+
+static void push_attrib(ParseContext *ctx, xml_Attrib attrib) {
+    AttribStack *stack = &ctx->attrib_stack;
+    if (stack->length >= stack->capacity) {
+        stack->capacity = stack->capacity == 0
+                              ? DYNARRAY_START_CAP
+                              : stack->capacity * DYNARRAY_GROWTH;
+        stack->attribs = mem_realloc(stack->attribs,
+                                     stack->capacity * sizeof(*stack->attribs));
+    }
+
+    stack->attribs[stack->length++] = attrib;
+}
+
+// Moves everything above `base` off the scratch stack and into the arena.
+static void pop_tokens(ParseContext *ctx, size_t base,
+                       xml_ContentList *content_list) {
+    TokenStack *stack = &ctx->token_stack;
+    size_t length = stack->length - base;
+    if (length == 0) {
+        return;
+    }
+
+    content_list->tokens =
+        arena_alloc(ctx->arena, length * sizeof(*content_list->tokens));
+    memcpy(content_list->tokens, &stack->tokens[base],
+           length * sizeof(*content_list->tokens));
+    content_list->length = length;
+    stack->length = base;
+}
+
+static void pop_attribs(ParseContext *ctx, size_t base, xml_Tag *tag) {
+    AttribStack *stack = &ctx->attrib_stack;
+    size_t length = stack->length - base;
+    if (length == 0) {
+        return;
+    }
+
+    tag->attribs.attribs =
+        arena_alloc(ctx->arena, length * sizeof(*tag->attribs.attribs));
+    memcpy(tag->attribs.attribs, &stack->attribs[base],
+           length * sizeof(*tag->attribs.attribs));
+    tag->attribs.length = length;
+    stack->length = base;
+}
+
+#define ATOM_START_SLOTS 256
+
+// Returns the slot that holds `name`, or the empty slot where it belongs.
+static size_t find_atom_slot(const xml_AtomTable *table, StringView name) {
+    size_t mask = table->slot_count - 1;
+    size_t slot = sv_hash(name) & mask;
+
+    while (table->slots[slot] != XML_ATOM_NONE &&
+           !sv_equal(table->names[table->slots[slot]], name)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void grow_atom_slots(xml_AtomTable *table) {
+    mem_free(table->slots);
+    table->slot_count =
+        table->slot_count == 0 ? ATOM_START_SLOTS : table->slot_count * 2;
+    table->slots = mem_calloc(table->slot_count, sizeof(*table->slots));
+
+    for (xml_Atom atom = 1; atom < table->count; atom++) {
+        table->slots[find_atom_slot(table, table->names[atom])] = atom;
+    }
+}
+
+static xml_Atom intern(xml_AtomTable *table, StringView name) {
+    // Keep the load factor at or below one half.
+    if (2 * table->count >= table->slot_count) {
+        grow_atom_slots(table);
+    }
+
+    // Index 0 is reserved for `XML_ATOM_NONE`.
+    if (table->count == 0) {
+        table->count = 1;
+    }
+
+    size_t slot = find_atom_slot(table, name);
+    if (table->slots[slot] != XML_ATOM_NONE) {
+        return table->slots[slot];
     }
 
-    if (content_list->length >= content_list->capacity) {
-        content_list->capacity *= DYNARRAY_GROWTH;
-        content_list->tokens =
-            realloc(content_list->tokens,
-                    content_list->capacity * sizeof(*content_list->tokens));
+    if (table->count >= table->capacity) {
+        table->capacity =
+            table->capacity == 0 ? DYNARRAY_START_CAP : table->capacity * 2;
+        table->names =
+            mem_realloc(table->names, table->capacity * sizeof(*table->names));
     }
 
-    content_list->tokens[content_list->length++] = content;
+    xml_Atom atom = (xml_Atom)table->count++;
+    table->names[atom] = name;
+    table->slots[slot] = atom;
+    return atom;
 }
 
-static void add_attrib(xml_Tag *tag, xml_Attrib attrib) {
-    xml_Attribs *attribs = &tag->attribs;
-    if (attribs->attribs == NULL) {
-        attribs->capacity = DYNARRAY_START_CAP;
-        attribs->attribs = calloc(attribs->capacity, sizeof(attrib));
+static xml_Atom intern_name(ParseContext *ctx, StringView name) {
+    xml_Atom atom = intern(ctx->atoms, name);
+    if (ctx->shared_atoms == NULL) {
+        return atom;
+    }
+
+    if (atom >= ctx->atom_map_capacity) {
+        size_t capacity = ctx->atoms->capacity;
+        ctx->atom_map =
+            mem_realloc(ctx->atom_map, capacity * sizeof(*ctx->atom_map));
+        memset(&ctx->atom_map[ctx->atom_map_capacity], 0,
+               (capacity - ctx->atom_map_capacity) * sizeof(*ctx->atom_map));
+        ctx->atom_map_capacity = capacity;
     }
 
-    if (attribs->length >= attribs->capacity) {
-        attribs->capacity *= DYNARRAY_GROWTH;
-        attribs->attribs = realloc(
-            attribs->attribs, attribs->capacity * sizeof(*attribs->attribs));
+    if (ctx->atom_map[atom] == XML_ATOM_NONE) {
+        mutex_lock(ctx->shared_atoms_lock);
+        ctx->atom_map[atom] = intern(ctx->shared_atoms, name);
+        mutex_unlock(ctx->shared_atoms_lock);
     }
 
-    attribs->attribs[attribs->length++] = attrib;
+    return ctx->atom_map[atom];
+}
+
+#define CHAR_SPACE 1
+#define CHAR_IDENT 2
+
+// Character classes of every byte, matching `isspace` and `isalnum` in the "C"
+// locale.
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#if defined(XML_SIMD_AVX2) || defined(XML_SIMD_SSE2)
+static unsigned lowest_set_bit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Returns the index of the first `ch` in `src[from..end)`, or `end` if there is
+// none.
+static size_t find_byte(const char *src, size_t from, size_t end, char ch) {
+#if defined(XML_SIMD_AVX2)
+    __m256i needle = _mm256_set1_epi8(ch);
+    for (; from + 32 <= end; from += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)&src[from]);
+        unsigned mask =
+            (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return from + lowest_set_bit(mask);
+        }
+    }
+#elif defined(XML_SIMD_SSE2)
+    __m128i needle = _mm_set1_epi8(ch);
+    for (; from + 16 <= end; from += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)&src[from]);
+        unsigned mask =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return from + lowest_set_bit(mask);
+        }
+    }
+#endif
+
+    const char *found = memchr(&src[from], ch, end - from);
+    return found ? (size_t)(found - src) : end;
+}
+
+// Reads the byte `offset` bytes past the cursor. Everything at or past the end
+// of the input reads as '\0', so the source needs no terminator.
+static char peek(const ParseContext *ctx, size_t offset) {
+    size_t index = ctx->cursor + offset;
+    return index < ctx->length ? ctx->src[index] : '\0';
+}
+
+static bool at_eof(const ParseContext *ctx) {
+    return ctx->cursor >= ctx->length;
+}
+
+static bool at_cstr(const ParseContext *ctx, const char *str) {
+    size_t length = strlen(str);
+    return ctx->length - ctx->cursor >= length &&
+           memcmp(&ctx->src[ctx->cursor], str, length) == 0;
 }
 
 static StringView take_until_tag(ParseContext *ctx) {
     StringView str = { 0 };
 
     str.start = &ctx->src[ctx->cursor];
-    while (ctx->src[ctx->cursor] != '<') {
-        if (ctx->src[ctx->cursor] == '\0') {
-            fprintf(
-                stderr,
+    size_t end = find_byte(ctx->src, ctx->cursor, ctx->length, '<');
+    if (end == ctx->length) {
+        fprintf(stderr,
                 "XML error: unexpected EOF while parsing text! (cursor=%d)\n",
                 (int)ctx->cursor);
-            break;
-        }
-        ctx->cursor++;
-        str.length++;
     }
 
+    str.length = end - ctx->cursor;
+    ctx->cursor = end;
     return str;
 }
 
 static void skip_whitespace(ParseContext *ctx) {
-    while (isspace(ctx->src[ctx->cursor])) {
+    while (char_class[(unsigned char)peek(ctx, 0)] & CHAR_SPACE) {
         ctx->cursor++;
     }
 }
@@ -78,7 +311,7 @@ static StringView parse_ident(ParseContext *ctx) {
     StringView str = { 0 };
     str.start = &ctx->src[ctx->cursor];
 
-    while (isalpha(ctx->src[ctx->cursor]) || isdigit(ctx->src[ctx->cursor])) {
+    while (char_class[(unsigned char)peek(ctx, 0)] & CHAR_IDENT) {
         ctx->cursor++;
         str.length++;
     }
@@ -87,7 +320,7 @@ static StringView parse_ident(ParseContext *ctx) {
 }
 
 static bool expect(ParseContext *ctx, char ch) {
-    if (ctx->src[ctx->cursor] == ch) {
+    if (!at_eof(ctx) && peek(ctx, 0) == ch) {
         ctx->cursor++;
         return true;
     }
@@ -98,9 +331,8 @@ static bool expect(ParseContext *ctx, char ch) {
 }
 
 static bool expect_cstr(ParseContext *ctx, const char *str) {
-    size_t length = convenient_strlen(str);
-    if (convenient_starts_with(&ctx->src[ctx->cursor], str)) {
-        ctx->cursor += length;
+    if (at_cstr(ctx, str)) {
+        ctx->cursor += strlen(str);
         return true;
     }
 
@@ -115,16 +347,14 @@ static StringView parse_string_literal(ParseContext *ctx) {
     StringView str = { 0 };
     str.start = &ctx->src[ctx->cursor];
 
-    while (ctx->src[ctx->cursor] != '"') {
-        if (ctx->src[ctx->cursor] == '\0') {
-            fprintf(stderr, "XML error: unexpected EOF!\n");
-            break;
-        }
-
-        ctx->cursor++;
-        str.length++;
+    size_t end = find_byte(ctx->src, ctx->cursor, ctx->length, '"');
+    if (end == ctx->length) {
+        fprintf(stderr, "XML error: unexpected EOF!\n");
     }
 
+    str.length = end - ctx->cursor;
+    ctx->cursor = end;
+
     expect(ctx, '"');
     return str;
 }
@@ -141,92 +371,174 @@ static xml_Attrib parse_attrib(ParseContext *ctx) {
 
 static bool attempt_parse_end_tag(ParseContext *ctx, StringView tag) {
     size_t cursor = ctx->cursor;
-    bool matches = true;
 
-    matches &= convenient_starts_with(&ctx->src[cursor], "</");
-    cursor += 2;
-    if (!matches) {
+    if (ctx->length - cursor < tag.length + 3 || ctx->src[cursor] != '<' ||
+        ctx->src[cursor + 1] != '/') {
         return false;
     }
+    cursor += 2;
 
-    matches &= cstr_starts_with_sv(&ctx->src[cursor], tag);
-    cursor += tag.length;
-    if (!matches) {
+    if (memcmp(&ctx->src[cursor], tag.start, tag.length) != 0) {
         return false;
     }
+    cursor += tag.length;
 
-    matches &= convenient_starts_with(&ctx->src[cursor], ">");
-    cursor++;
-    if (!matches) {
+    if (ctx->src[cursor] != '>') {
         return false;
     }
+    cursor++;
 
     ctx->cursor = cursor;
     return true;
 }
 
+// Returns the index of the '>' that ends the tag starting at `from`, skipping
+// over quoted attribute values, or `length` if the tag is incomplete.
+static size_t find_tag_end(const char *src, size_t from, size_t length) {
+    size_t i = from;
+    while (i < length) {
+        if (src[i] == '"') {
+            i = find_byte(src, i + 1, length, '"');
+            if (i == length) {
+                break;
+            }
+        } else if (src[i] == '>') {
+            return i;
+        }
+        i++;
+    }
+    return length;
+}
+
+static void skip_comment(ParseContext *ctx) {
+    expect_cstr(ctx, "<!--");
+
+    while (true) {
+        ctx->cursor = find_byte(ctx->src, ctx->cursor, ctx->length, '-');
+        if (at_eof(ctx) || at_cstr(ctx, "-->")) {
+            break;
+        }
+        ctx->cursor++;
+    }
+
+    if (ctx->cursor == ctx->length) {
+        fprintf(stderr, "XML error: unterminated comment!\n");
+    } else {
+        // Account for "-->"
+        ctx->cursor += 3;
+    }
+}
+
+// Skips the content of an element up to and including its end tag without
+// building any tokens. Only the nesting depth is tracked on the way.
+static void skip_content(ParseContext *ctx, StringView tag) {
+    size_t depth = 1;
+
+    while (true) {
+        ctx->cursor = find_byte(ctx->src, ctx->cursor, ctx->length, '<');
+        if (at_eof(ctx)) {
+            fprintf(stderr, "XML error: expected closing tag, but got EOF!\n");
+            return;
+        }
+
+        if (peek(ctx, 1) == '!' && at_cstr(ctx, "<!--")) {
+            skip_comment(ctx);
+            continue;
+        }
+
+        if (peek(ctx, 1) == '/' && --depth == 0) {
+            if (!attempt_parse_end_tag(ctx, tag)) {
+                fprintf(stderr, "XML error: expected closing tag `%.*s`!\n",
+                        (int)tag.length, tag.start);
+                longjmp(ctx->on_error, 1);
+            }
+            return;
+        }
+
+        size_t end = find_tag_end(ctx->src, ctx->cursor, ctx->length);
+        if (end == ctx->length) {
+            ctx->cursor = end;
+            continue;
+        }
+
+        bool opens = peek(ctx, 1) != '/' && peek(ctx, 1) != '!' &&
+                     peek(ctx, 1) != '?' && ctx->src[end - 1] != '/';
+        if (opens) {
+            depth++;
+        }
+        ctx->cursor = end + 1;
+    }
+}
+
 static xml_Token parse_xml(ParseContext *ctx);
 
-static xml_ContentList parse_content(ParseContext *ctx) {
-    xml_ContentList content_list = { 0 };
+static void parse_children(ParseContext *ctx, xml_ContentList *content_list) {
+    size_t token_base = ctx->token_stack.length;
+    while (!attempt_parse_end_tag(ctx, content_list->tag.name)) {
+        if (at_eof(ctx)) {
+            fprintf(stderr, "XML error: expected closing tag, but got EOF!\n");
+            break;
+        }
+        xml_Token next_token = parse_xml(ctx);
+        push_token(ctx, next_token);
+    }
+    pop_tokens(ctx, token_base, content_list);
+}
 
+// Parses a start tag and its attributes. Returns whether the element has
+// content, i.e. whether the tag isn't self-closing.
+static bool parse_start_tag(ParseContext *ctx, xml_ContentList *content_list) {
     expect(ctx, '<');
     skip_whitespace(ctx);
-    content_list.tag.name = parse_ident(ctx);
+    content_list->tag.name = parse_ident(ctx);
+    content_list->tag.atom = intern_name(ctx, content_list->tag.name);
     skip_whitespace(ctx);
 
-    while (ctx->src[ctx->cursor] != '>' && ctx->src[ctx->cursor] != '/') {
+    size_t attrib_base = ctx->attrib_stack.length;
+    while (!at_eof(ctx) && peek(ctx, 0) != '>' && peek(ctx, 0) != '/') {
         xml_Attrib attrib = parse_attrib(ctx);
-        add_attrib(&content_list.tag, attrib);
+        attrib.atom = intern_name(ctx, attrib.name);
+        push_attrib(ctx, attrib);
         skip_whitespace(ctx);
     }
+    pop_attribs(ctx, attrib_base, &content_list->tag);
 
     // Self-closing tag
-    if (ctx->src[ctx->cursor] == '/') {
+    if (peek(ctx, 0) == '/') {
         expect_cstr(ctx, "/>");
-    } else {
-        expect(ctx, '>');
-        while (!attempt_parse_end_tag(ctx, content_list.tag.name)) {
-            if (ctx->src[ctx->cursor] == '\0') {
-                fprintf(stderr,
-                        "XML error: expected closing tag, but got EOF!\n");
-                break;
-            }
-            xml_Token next_token = parse_xml(ctx);
-            add_content(&content_list, next_token);
-        }
+        return false;
     }
 
-    return content_list;
+    expect(ctx, '>');
+    return true;
 }
 
-static void skip_comment(ParseContext *ctx) {
-    expect_cstr(ctx, "<!--");
+static xml_ContentList parse_content(ParseContext *ctx) {
+    xml_ContentList content_list = { 0 };
 
-    while (ctx->src[ctx->cursor] != '\0' &&
-           !convenient_starts_with(&ctx->src[ctx->cursor], "-->")) {
-        ctx->cursor++;
+    if (parse_start_tag(ctx, &content_list)) {
+        if (ctx->lazy) {
+            content_list.unparsed = &ctx->src[ctx->cursor];
+            skip_content(ctx, content_list.tag.name);
+        } else {
+            parse_children(ctx, &content_list);
+        }
     }
 
-    if (ctx->src[ctx->cursor] == '\0') {
-        fprintf(stderr, "XML error: unterminated comment!\n");
-    } else {
-        // Account for "-->"
-        ctx->cursor += 3;
-    }
+    return content_list;
 }
 
 static xml_Token parse_xml(ParseContext *ctx) {
     xml_Token token = { 0 };
 
-    if (convenient_starts_with(&ctx->src[ctx->cursor], "<!--")) {
+    if (peek(ctx, 0) == '<' && peek(ctx, 1) == '!' && at_cstr(ctx, "<!--")) {
         skip_comment(ctx);
     }
 
-    if (ctx->src[ctx->cursor] == '<') {
+    if (peek(ctx, 0) == '<') {
         token.type = XML_TOKEN_NODE;
         token.value.content = parse_content(ctx);
-    } else if (ctx->src[ctx->cursor] != '\0') {
+    } else if (!at_eof(ctx)) {
         token.type = XML_TOKEN_TEXT;
         token.value.text = take_until_tag(ctx);
     }
@@ -234,92 +546,1009 @@ static xml_Token parse_xml(ParseContext *ctx) {
     return token;
 }
 
-static void free_recursively(xml_ContentList content) {
-    for (size_t i = 0; i < content.length; i++) {
-        if (content.tokens[i].type == XML_TOKEN_NODE) {
-            free_recursively(content.tokens[i].value.content);
+typedef struct {
+    xml_ContentList *content_list;
+    // Index of the element in its parent's content.
+    size_t index;
+    size_t size;
+    size_t worker;
+} ParseTask;
+
+typedef struct {
+    ParseTask *tasks;
+    size_t length;
+    size_t capacity;
+} ParseTaskList;
+
+typedef struct {
+    const char *src;
+    size_t length;
+    size_t id;
+    const ParseTaskList *tasks;
+    xml_AtomTable *shared_atoms;
+    Mutex *shared_atoms_lock;
+    Arena arena;
+    bool success;
+} ParseWorker;
+
+static void push_task(ParseTaskList *list, ParseTask task) {
+    if (list->length >= list->capacity) {
+        list->capacity = list->capacity == 0 ? DYNARRAY_START_CAP
+                                             : list->capacity * DYNARRAY_GROWTH;
+        list->tasks =
+            mem_realloc(list->tasks, list->capacity * sizeof(*list->tasks));
+    }
+
+    list->tasks[list->length++] = task;
+}
+
+// Parses one level of an unparsed element, skipping the content of its
+// children, and turns every child that still has content into a task. Children
+// bigger than `split_size` are split once more.
+static void plan_tasks(ParseContext *ctx, xml_ContentList *content_list,
+                       size_t split_size, bool split, ParseTaskList *tasks) {
+    ctx->cursor = (size_t)(content_list->unparsed - ctx->src);
+
+    size_t first_task = tasks->length;
+    size_t token_base = ctx->token_stack.length;
+    while (!attempt_parse_end_tag(ctx, content_list->tag.name)) {
+        if (at_eof(ctx)) {
+            fprintf(stderr, "XML error: expected closing tag, but got EOF!\n");
+            break;
+        }
+
+        size_t start = ctx->cursor;
+        xml_Token child = parse_xml(ctx);
+        if (child.type == XML_TOKEN_NODE &&
+            child.value.content.unparsed != NULL) {
+            push_task(tasks, (ParseTask){
+                                 .index = ctx->token_stack.length - token_base,
+                                 .size = ctx->cursor - start,
+                             });
+        }
+        push_token(ctx, child);
+    }
+    pop_tokens(ctx, token_base, content_list);
+    content_list->unparsed = NULL;
+
+    // The children only have their final address once they're in the arena.
+    size_t last_task = tasks->length;
+    for (size_t i = first_task; i < last_task; i++) {
+        ParseTask *task = &tasks->tasks[i];
+        task->content_list = &content_list->tokens[task->index].value.content;
+    }
+
+    if (!split) {
+        return;
+    }
+
+    size_t kept = first_task;
+    for (size_t i = first_task; i < last_task; i++) {
+        ParseTask task = tasks->tasks[i];
+        if (task.size > split_size) {
+            plan_tasks(ctx, task.content_list, split_size, false, tasks);
+        } else {
+            tasks->tasks[kept++] = task;
         }
     }
-    free(content.tokens);
-    free(content.tag.attribs.attribs);
+
+    // Move the tasks of the split children down over the ones they replace.
+    memmove(&tasks->tasks[kept], &tasks->tasks[last_task],
+            (tasks->length - last_task) * sizeof(*tasks->tasks));
+    tasks->length -= last_task - kept;
+}
+
+static int compare_tasks(const void *a, const void *b) {
+    size_t size_a = ((const ParseTask *)a)->size;
+    size_t size_b = ((const ParseTask *)b)->size;
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+// Hands out the biggest tasks first, each to the least loaded worker.
+static void assign_tasks(ParseTaskList *tasks, size_t worker_count) {
+    qsort(tasks->tasks, tasks->length, sizeof(*tasks->tasks), compare_tasks);
+
+    size_t *loads = mem_calloc(worker_count, sizeof(*loads));
+    for (size_t i = 0; i < tasks->length; i++) {
+        size_t worker = 0;
+        for (size_t j = 1; j < worker_count; j++) {
+            if (loads[j] < loads[worker]) {
+                worker = j;
+            }
+        }
+        tasks->tasks[i].worker = worker;
+        loads[worker] += tasks->tasks[i].size;
+    }
+    mem_free(loads);
+}
+
+static void parse_worker(void *arg) {
+    ParseWorker *worker = arg;
+    xml_AtomTable atoms = { 0 };
+    ParseContext ctx = {
+        .src = worker->src,
+        .length = worker->length,
+        .arena = &worker->arena,
+        .atoms = &atoms,
+        .shared_atoms = worker->shared_atoms,
+        .shared_atoms_lock = worker->shared_atoms_lock,
+    };
+
+    worker->success = false;
+    if (setjmp(ctx.on_error) == 0) {
+        for (size_t i = 0; i < worker->tasks->length; i++) {
+            const ParseTask *task = &worker->tasks->tasks[i];
+            if (task->worker != worker->id) {
+                continue;
+            }
+
+            ctx.cursor = (size_t)(task->content_list->unparsed - ctx.src);
+            parse_children(&ctx, task->content_list);
+            task->content_list->unparsed = NULL;
+        }
+        worker->success = true;
+    }
+
+    mem_free(ctx.token_stack.tokens);
+    mem_free(ctx.attrib_stack.attribs);
+    mem_free(ctx.atom_map);
+    mem_free(atoms.names);
+    mem_free(atoms.slots);
 }
 
-void xml_free(xml_Token root) {
-    if (root.type == XML_TOKEN_TEXT) {
+// Splits the children of the root, whose start tag has just been parsed, into
+// tasks and parses them on `thread_count` threads. Each worker fills its own
+// arena, which is merged into the document's afterwards.
+static bool parse_parallel(ParseContext *ctx, xml_Document *doc,
+                           size_t thread_count, ParseTaskList *tasks) {
+    // Sections bigger than a thread's fair share are split into their children.
+    plan_tasks(ctx, &doc->root.value.content, ctx->length / thread_count, true,
+               tasks);
+
+    size_t worker_count =
+        tasks->length < thread_count ? tasks->length : thread_count;
+    assign_tasks(tasks, worker_count);
+
+    Mutex atoms_lock;
+    mutex_init(&atoms_lock);
+
+    ParseWorker *workers = mem_calloc(worker_count, sizeof(*workers));
+    Thread *threads = mem_calloc(worker_count, sizeof(*threads));
+    for (size_t i = 0; i < worker_count; i++) {
+        workers[i] = (ParseWorker){
+            .src = ctx->src,
+            .length = ctx->length,
+            .id = i,
+            .tasks = tasks,
+            .shared_atoms = &doc->atoms,
+            .shared_atoms_lock = &atoms_lock,
+        };
+    }
+
+    // The calling thread doubles as the first worker, and takes over the
+    // tasks of any thread that fails to start.
+    size_t started = 1;
+    while (started < worker_count &&
+           thread_start(&threads[started], parse_worker, &workers[started])) {
+        started++;
+    }
+    if (worker_count > 0) {
+        parse_worker(&workers[0]);
+    }
+    for (size_t i = started; i < worker_count; i++) {
+        parse_worker(&workers[i]);
+    }
+    for (size_t i = 1; i < started; i++) {
+        thread_join(&threads[i]);
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < worker_count; i++) {
+        success = success && workers[i].success;
+        arena_absorb(&doc->arena, &workers[i].arena);
+    }
+
+    mutex_destroy(&atoms_lock);
+    mem_free(workers);
+    mem_free(threads);
+    return success;
+}
+
+#define SAX_CHUNK_SIZE (64 * 1024)
+
+void xml_sax_init(xml_SaxParser *parser, xml_SaxHandler handler) {
+    *parser = (xml_SaxParser){ .handler = handler };
+}
+
+void xml_sax_free(xml_SaxParser *parser) {
+    mem_free(parser->buffer);
+    mem_free(parser->open_names);
+    mem_free(parser->open_offsets);
+    *parser = (xml_SaxParser){ 0 };
+}
+
+static void sax_push_name(xml_SaxParser *parser, StringView name) {
+    if (parser->open_names_length + name.length >
+        parser->open_names_capacity) {
+        while (parser->open_names_length + name.length >
+               parser->open_names_capacity) {
+            parser->open_names_capacity =
+                parser->open_names_capacity == 0
+                    ? DYNARRAY_START_CAP
+                    : parser->open_names_capacity * DYNARRAY_GROWTH;
+        }
+        parser->open_names =
+            mem_realloc(parser->open_names, parser->open_names_capacity);
+    }
+
+    if (parser->depth + 1 >= parser->open_offsets_capacity) {
+        parser->open_offsets_capacity =
+            parser->open_offsets_capacity == 0
+                ? DYNARRAY_START_CAP
+                : parser->open_offsets_capacity * DYNARRAY_GROWTH;
+        parser->open_offsets =
+            mem_realloc(parser->open_offsets, parser->open_offsets_capacity *
+                                              sizeof(*parser->open_offsets));
+    }
+
+    if (parser->depth == 0) {
+        parser->open_offsets[0] = 0;
+    }
+
+    memcpy(&parser->open_names[parser->open_names_length], name.start,
+           name.length);
+    parser->open_names_length += name.length;
+    parser->open_offsets[++parser->depth] = parser->open_names_length;
+}
+
+static StringView sax_top_name(const xml_SaxParser *parser) {
+    size_t start = parser->open_offsets[parser->depth - 1];
+    return (StringView){
+        .start = &parser->open_names[start],
+        .length = parser->open_offsets[parser->depth] - start,
+    };
+}
+
+// Parses the start tag in `buffer[from..end)` and reports it.
+static bool sax_start_tag(xml_SaxParser *parser, size_t from, size_t end) {
+    ParseContext ctx = {
+        .src = parser->buffer,
+        .length = end,
+        .cursor = from,
+    };
+
+    xml_SaxHandler *handler = &parser->handler;
+    if (setjmp(ctx.on_error)) {
+        return false;
+    }
+
+    expect(&ctx, '<');
+    skip_whitespace(&ctx);
+    StringView name = parse_ident(&ctx);
+    if (handler->start_element) {
+        handler->start_element(handler->user, name);
+    }
+    skip_whitespace(&ctx);
+
+    while (!at_eof(&ctx) && peek(&ctx, 0) != '>' && peek(&ctx, 0) != '/') {
+        xml_Attrib attrib = parse_attrib(&ctx);
+        if (handler->attribute) {
+            handler->attribute(handler->user, attrib.name, attrib.value);
+        }
+        skip_whitespace(&ctx);
+    }
+
+    if (peek(&ctx, 0) == '/') {
+        expect_cstr(&ctx, "/>");
+        if (handler->end_element) {
+            handler->end_element(handler->user, name);
+        }
+    } else {
+        expect(&ctx, '>');
+        sax_push_name(parser, name);
+    }
+
+    parser->seen_root = true;
+    return true;
+}
+
+static bool sax_end_tag(xml_SaxParser *parser, size_t from, size_t end) {
+    ParseContext ctx = {
+        .src = parser->buffer,
+        .length = end,
+        .cursor = from + 2,
+    };
+
+    skip_whitespace(&ctx);
+    StringView name = parse_ident(&ctx);
+    skip_whitespace(&ctx);
+
+    if (parser->depth == 0 || !sv_equal(name, sax_top_name(parser)) ||
+        ctx.cursor + 1 != end) {
+        fprintf(stderr, "XML error: unexpected closing tag `%.*s`!\n",
+                (int)name.length, name.start);
+        return false;
+    }
+
+    if (parser->handler.end_element) {
+        parser->handler.end_element(parser->handler.user, name);
+    }
+
+    parser->depth--;
+    parser->open_names_length = parser->open_offsets[parser->depth];
+    return true;
+}
+
+// Consumes every complete construct in the buffer. Incomplete input is left
+// in place until more is fed.
+static bool sax_process(xml_SaxParser *parser, bool at_eof) {
+    const char *buffer = parser->buffer;
+
+    while (parser->cursor < parser->length) {
+        size_t cursor = parser->cursor;
+        size_t available = parser->length - cursor;
+
+        if (buffer[cursor] != '<') {
+            size_t end = find_byte(buffer, cursor, parser->length, '<');
+            StringView text = { &buffer[cursor], end - cursor };
+
+            if (parser->depth > 0) {
+                if (parser->handler.text) {
+                    parser->handler.text(parser->handler.user, text);
+                }
+            } else {
+                for (size_t i = 0; i < text.length; i++) {
+                    if (!(char_class[(unsigned char)text.start[i]] &
+                          CHAR_SPACE)) {
+                        fprintf(stderr,
+                                "XML error: text outside of the root!\n");
+                        return false;
+                    }
+                }
+            }
+
+            parser->cursor = end;
+            continue;
+        }
+
+        if (available < 2) {
+            break;
+        }
+
+        if (buffer[cursor + 1] == '!' || buffer[cursor + 1] == '?') {
+            // Comments, the XML declaration and other markup declarations
+            // carry nothing a handler can use.
+            const char *terminator = buffer[cursor + 1] == '?' ? "?>" : ">";
+            size_t end = cursor + 2;
+
+            if (available < 4) {
+                break;
+            }
+
+            if (memcmp(&buffer[cursor], "<!--", 4) == 0) {
+                terminator = "-->";
+                end = cursor + 4;
+            }
+
+            size_t terminator_length = strlen(terminator);
+            while (true) {
+                end = find_byte(buffer, end, parser->length, terminator[0]);
+                if (end == parser->length ||
+                    (parser->length - end >= terminator_length &&
+                     memcmp(&buffer[end], terminator, terminator_length) ==
+                         0)) {
+                    break;
+                }
+                end++;
+            }
+
+            if (end == parser->length ||
+                parser->length - end < terminator_length) {
+                break;
+            }
+
+            parser->cursor = end + terminator_length;
+            continue;
+        }
+
+        size_t end = find_tag_end(buffer, cursor, parser->length);
+        if (end == parser->length) {
+            break;
+        }
+        end++;
+
+        bool ok;
+        if (buffer[cursor + 1] == '/') {
+            ok = sax_end_tag(parser, cursor, end);
+        } else if (parser->depth == 0 && parser->seen_root) {
+            fprintf(stderr, "XML error: more than one root element!\n");
+            ok = false;
+        } else {
+            ok = sax_start_tag(parser, cursor, end);
+        }
+
+        if (!ok) {
+            return false;
+        }
+
+        parser->cursor = end;
+    }
+
+    if (at_eof && (parser->cursor < parser->length || parser->depth > 0 ||
+                   !parser->seen_root)) {
+        fprintf(stderr, "XML error: unexpected EOF!\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool xml_sax_feed(xml_SaxParser *parser, const char *chunk, size_t length) {
+    if (parser->failed) {
+        return false;
+    }
+
+    // Drop the consumed prefix before appending.
+    if (parser->cursor > 0) {
+        parser->length -= parser->cursor;
+        memmove(parser->buffer, &parser->buffer[parser->cursor],
+                parser->length);
+        parser->cursor = 0;
+    }
+
+    if (parser->length + length > parser->capacity) {
+        while (parser->length + length > parser->capacity) {
+            parser->capacity = parser->capacity == 0
+                                   ? SAX_CHUNK_SIZE
+                                   : parser->capacity * DYNARRAY_GROWTH;
+        }
+        parser->buffer = mem_realloc(parser->buffer, parser->capacity);
+    }
+
+    // The scanner is bounded by `length`, so the buffer needs no terminator.
+    if (length > 0) {
+        memcpy(&parser->buffer[parser->length], chunk, length);
+        parser->length += length;
+    }
+
+    parser->failed = !sax_process(parser, false);
+    return !parser->failed;
+}
+
+bool xml_sax_finish(xml_SaxParser *parser) {
+    if (parser->failed) {
+        return false;
+    }
+
+    parser->failed = !sax_process(parser, true);
+    return !parser->failed;
+}
+
+bool xml_sax_parse_stream(FILE *file, xml_SaxHandler handler) {
+    xml_SaxParser parser;
+    xml_sax_init(&parser, handler);
+
+    char *chunk = mem_malloc(SAX_CHUNK_SIZE);
+    bool success = true;
+    size_t read;
+
+    while (success && (read = fread(chunk, 1, SAX_CHUNK_SIZE, file)) > 0) {
+        success = xml_sax_feed(&parser, chunk, read);
+    }
+
+    if (success && ferror(file)) {
+        fprintf(stderr, "XML error: failed to read input!\n");
+        success = false;
+    }
+
+    if (success) {
+        success = xml_sax_finish(&parser);
+    }
+
+    mem_free(chunk);
+    xml_sax_free(&parser);
+    return success;
+}
+
+void xml_free(xml_Document *doc) {
+    arena_free(&doc->arena);
+    mem_free(doc->atoms.names);
+    mem_free(doc->atoms.slots);
+    mem_free(doc->scratch_tokens);
+    mem_free(doc->scratch_attribs);
+    *doc = (xml_Document){ 0 };
+}
+
+typedef struct {
+    xml_Document *doc;
+    xml_WriteFilter filter;
+    void *user;
+    bool self_closing;
+    FILE *file;
+} WriteContext;
+
+static void write_span(WriteContext *ctx, StringView span) {
+    fwrite(span.start, 1, span.length, ctx->file);
+}
+
+static void write_element(WriteContext *ctx, xml_Token *token,
+                          xml_WriteMode mode);
+
+static void write_token(WriteContext *ctx, xml_Token *token) {
+    if (token->type == XML_TOKEN_TEXT) {
+        write_span(ctx, token->value.text);
+    } else {
+        write_element(ctx, token, XML_WRITE_ALL);
+    }
+}
+
+// Writes the children of a filtered element. Text is held back until the
+// next element is known to be kept, so that left out elements don't leave
+// their indentation behind.
+static void write_filtered_children(WriteContext *ctx,
+                                    xml_ContentList *content) {
+    size_t pending = 0;
+    for (size_t i = 0; i < content->length; i++) {
+        xml_Token *child = &content->tokens[i];
+        if (child->type == XML_TOKEN_TEXT) {
+            continue;
+        }
+
+        xml_WriteMode mode = ctx->filter(ctx->user, child);
+        if (mode != XML_WRITE_SKIP) {
+            for (; pending < i; pending++) {
+                write_token(ctx, &content->tokens[pending]);
+            }
+            write_element(ctx, child, mode);
+        }
+        pending = i + 1;
+    }
+
+    for (; pending < content->length; pending++) {
+        write_token(ctx, &content->tokens[pending]);
+    }
+}
+
+static void write_element(WriteContext *ctx, xml_Token *token,
+                          xml_WriteMode mode) {
+    if (ctx->doc != NULL && mode != XML_WRITE_TAG) {
+        xml_expand(ctx->doc, token);
+    }
+
+    xml_ContentList *content = &token->value.content;
+    xml_Attribs attribs = content->tag.attribs;
+
+    fputc('<', ctx->file);
+    write_span(ctx, content->tag.name);
+    for (size_t i = 0; i < attribs.length; i++) {
+        fputc(' ', ctx->file);
+        write_span(ctx, attribs.attribs[i].name);
+        fputs("=\"", ctx->file);
+        write_span(ctx, attribs.attribs[i].value);
+        fputc('"', ctx->file);
+    }
+
+    if (mode == XML_WRITE_TAG || (content->length == 0 && ctx->self_closing)) {
+        fputs("/>", ctx->file);
         return;
     }
-    free_recursively(root.value.content);
+    fputc('>', ctx->file);
+
+    if (mode == XML_WRITE_FILTER) {
+        write_filtered_children(ctx, content);
+    } else {
+        for (size_t i = 0; i < content->length; i++) {
+            write_token(ctx, &content->tokens[i]);
+        }
+    }
+
+    fputs("</", ctx->file);
+    write_span(ctx, content->tag.name);
+    fputc('>', ctx->file);
 }
 
 void xml_debug_print(FILE *file, xml_Token root) {
-    if (root.type == XML_TOKEN_TEXT) {
-        fprintf(file, "%.*s", (int)root.value.text.length,
-                root.value.text.start);
+    WriteContext ctx = { .file = file };
+    write_token(&ctx, &root);
+}
+
+bool xml_write_document(xml_Document *doc, xml_WriteFilter filter, void *user,
+                        FILE *file) {
+    WriteContext ctx = {
+        .doc = doc,
+        .filter = filter,
+        .user = user,
+        .self_closing = true,
+        .file = file,
+    };
+
+    fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n", file);
+    if (doc->root.type == XML_TOKEN_TEXT) {
+        write_token(&ctx, &doc->root);
     } else {
-        xml_ContentList content = root.value.content;
-        StringView tag_name = content.tag.name;
-        xml_Attribs attribs = content.tag.attribs;
+        xml_WriteMode mode =
+            filter != NULL ? filter(user, &doc->root) : XML_WRITE_ALL;
+        if (mode != XML_WRITE_SKIP) {
+            write_element(&ctx, &doc->root, mode);
+        }
+    }
+    fputc('\n', file);
+
+    return !ferror(file);
+}
+
+#define READ_CHUNK_SIZE (64 * 1024)
+
+// Reads everything that is left in `fp`, which doesn't have to be seekable.
+// The result is NUL-terminated but the terminator isn't counted in `length`.
+static char *read_stream(FILE *fp, size_t *length) {
+    size_t capacity = READ_CHUNK_SIZE;
+
+    // Size the buffer up front when the stream can tell us how long it is.
+    long end;
+    if (fseek(fp, 0, SEEK_END) == 0 && (end = ftell(fp)) >= 0) {
+        capacity = (size_t)end + 1;
+    }
+    rewind(fp);
+    clearerr(fp);
 
-        fprintf(file, "<%.*s", (int)tag_name.length, tag_name.start);
-        for (size_t i = 0; i < attribs.length; i++) {
-            xml_Attrib attrib = attribs.attribs[i];
-            fprintf(file, " %.*s=\"%.*s\"", (int)attrib.name.length,
-                    attrib.name.start, (int)attrib.value.length,
-                    attrib.value.start);
+    char *buffer = mem_malloc(capacity);
+    *length = 0;
+
+    while (buffer != NULL) {
+        size_t read = fread(&buffer[*length], 1, capacity - *length - 1, fp);
+        *length += read;
+        if (*length + 1 < capacity) {
+            // A short read means end of file or an error.
+            break;
         }
-        fputc('>', file);
 
-        for (size_t j = 0; j < content.length; j++) {
-            xml_debug_print(file, content.tokens[j]);
+        // A sized read fills the buffer exactly, so probe for more input
+        // before growing it.
+        int next = fgetc(fp);
+        if (next == EOF) {
+            break;
         }
 
-        fprintf(file, "</%.*s>", (int)tag_name.length, tag_name.start);
+        capacity *= 2;
+        char *grown = mem_realloc(buffer, capacity);
+        if (grown == NULL) {
+            mem_free(buffer);
+            return NULL;
+        }
+        buffer = grown;
+        buffer[(*length)++] = (char)next;
     }
+
+    if (buffer == NULL || ferror(fp)) {
+        mem_free(buffer);
+        return NULL;
+    }
+
+    buffer[*length] = '\0';
+    return buffer;
 }
 
 char *xml_read_file(const char *file_name) {
-    FILE *fp = fopen(file_name, "r");
+    FILE *fp = fopen(file_name, "rb");
     if (!fp) {
         fprintf(stderr, "Error opening file `%s`!\n", file_name);
         return NULL;
     }
 
     size_t length;
-    fseek(fp, 0, SEEK_END);
-    length = ftell(fp);
-    rewind(fp);
+    char *input_buffer = read_stream(fp, &length);
+    if (input_buffer == NULL) {
+        fprintf(stderr, "Error reading file `%s`!\n", file_name);
+    }
+
+    fclose(fp);
+    return input_buffer;
+}
+
+#ifndef _WIN32
+static bool map_file(const char *file_name, xml_Input *input) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
 
-    char *input_buffer = malloc(length + 1);
-    size_t elements_read = fread(input_buffer, 1, length, fp);
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    input->data = data;
+    input->length = (size_t)info.st_size;
+    input->mapped = true;
+    return true;
+}
+#endif
 
-    // TODO: this should really be checked but I don't have time for that now.
-    (void)elements_read;
+bool xml_open_input(const char *file_name, xml_Input *input) {
+    *input = (xml_Input){ 0 };
 
-    input_buffer[length] = '\0';
+#ifndef _WIN32
+    if (map_file(file_name, input)) {
+        return true;
+    }
+#endif
+
+    // Pipes, empty files and platforms without mmap are read into memory.
+    FILE *fp = fopen(file_name, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening file `%s`!\n", file_name);
+        return false;
+    }
+
+    char *data = read_stream(fp, &input->length);
     fclose(fp);
+    if (data == NULL) {
+        fprintf(stderr, "Error reading file `%s`!\n", file_name);
+        return false;
+    }
 
-    return input_buffer;
+    input->data = data;
+    return true;
+}
+
+void xml_close_input(xml_Input *input) {
+#ifndef _WIN32
+    if (input->mapped) {
+        munmap((void *)input->data, input->length);
+        *input = (xml_Input){ 0 };
+        return;
+    }
+#endif
+
+    mem_free((void *)input->data);
+    *input = (xml_Input){ 0 };
 }
 
-bool xml_parse_file(const char *src, xml_Token *token) {
+bool xml_parse_file(const char *src, size_t length, xml_ParseOptions options,
+                    xml_Document *doc) {
+    *doc = (xml_Document){
+        .src = src,
+        .length = length,
+        .lazy = options.lazy,
+    };
+
     ParseContext ctx = {
         .src = src,
+        .length = length,
         .cursor = 0,
+        .arena = &doc->arena,
+        .atoms = &doc->atoms,
+        .lazy = options.lazy,
     };
+    ParseTaskList tasks = { 0 };
 
-    if (!expect_cstr(&ctx, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>")) {
-        fprintf(stderr, "XML error: failed to parse header!\n");
-        return false;
+    // Set after setjmp, so it has to survive a longjmp.
+    volatile bool success = false;
+    if (setjmp(ctx.on_error)) {
+        fprintf(stderr, "XML error: parsing failed!\n");
+        xml_free(doc);
+    } else {
+        expect_cstr(&ctx, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+        skip_whitespace(&ctx);
+
+        if (!options.lazy && options.threads > 1 && peek(&ctx, 0) == '<' &&
+            peek(&ctx, 1) != '!') {
+            // Only the start tag of the root is parsed here. Its sections are
+            // filled in by the workers.
+            doc->root.type = XML_TOKEN_NODE;
+            xml_ContentList *root = &doc->root.value.content;
+            if (parse_start_tag(&ctx, root)) {
+                root->unparsed = &ctx.src[ctx.cursor];
+                ctx.lazy = true;
+                if (!parse_parallel(&ctx, doc, options.threads, &tasks)) {
+                    longjmp(ctx.on_error, 1);
+                }
+            }
+        } else {
+            doc->root = parse_xml(&ctx);
+        }
+        success = true;
     }
 
+    mem_free(ctx.token_stack.tokens);
+    mem_free(ctx.attrib_stack.attribs);
+    mem_free(tasks.tasks);
+    return success;
+}
+
+static void load_compact_node(xml_Document *doc, uint32_t node,
+                              xml_Token *token) {
+    const xml_CompactDom *dom = doc->compact;
+    if (dom->types[node] == XML_TOKEN_TEXT) {
+        *token = (xml_Token){
+            .type = XML_TOKEN_TEXT,
+            .value.text = xml_compact_name(dom, node),
+        };
+        return;
+    }
+
+    token->type = XML_TOKEN_NODE;
+    xml_ContentList *content_list = &token->value.content;
+    *content_list = (xml_ContentList){
+        .tag.name = xml_compact_name(dom, node),
+        .tag.atom = dom->atoms[node],
+    };
+
+    uint32_t first_attrib = dom->first_attrib[node];
+    size_t attrib_count = dom->first_attrib[node + 1] - first_attrib;
+    if (attrib_count > 0) {
+        xml_Attrib *attribs =
+            arena_alloc(&doc->arena, attrib_count * sizeof(*attribs));
+        for (size_t i = 0; i < attrib_count; i++) {
+            uint32_t attrib = first_attrib + (uint32_t)i;
+            attribs[i] = (xml_Attrib){
+                .name = {
+                    .start = &dom->src[dom->attrib_name_offsets[attrib]],
+                    .length = dom->attrib_name_lengths[attrib],
+                },
+                .value = {
+                    .start = &dom->src[dom->attrib_value_offsets[attrib]],
+                    .length = dom->attrib_value_lengths[attrib],
+                },
+                .atom = dom->attrib_atoms[attrib],
+            };
+        }
+        content_list->tag.attribs = (xml_Attribs){
+            .attribs = attribs,
+            .length = attrib_count,
+        };
+    }
+
+    if (dom->first_child[node] != XML_COMPACT_NONE) {
+        content_list->unparsed = content_list->tag.name.start;
+    }
+}
+
+// Finds an element's node from the position of its name, as nodes are stored
+// in document order.
+static uint32_t find_compact_node(const xml_CompactDom *dom,
+                                  const char *name) {
+    uint32_t offset = (uint32_t)(name - dom->src);
+    uint32_t low = 0;
+    uint32_t high = dom->node_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (dom->offsets[middle] < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static void expand_compact(xml_Document *doc, xml_ContentList *content_list) {
+    const xml_CompactDom *dom = doc->compact;
+    uint32_t node = find_compact_node(dom, content_list->tag.name.start);
+
+    size_t length = 0;
+    for (uint32_t child = dom->first_child[node]; child != XML_COMPACT_NONE;
+         child = dom->next_sibling[child]) {
+        length++;
+    }
+
+    content_list->tokens =
+        arena_alloc(&doc->arena, length * sizeof(*content_list->tokens));
+    content_list->length = length;
+    content_list->unparsed = NULL;
+
+    size_t i = 0;
+    for (uint32_t child = dom->first_child[node]; child != XML_COMPACT_NONE;
+         child = dom->next_sibling[child]) {
+        load_compact_node(doc, child, &content_list->tokens[i++]);
+    }
+}
+
+bool xml_load_compact(const xml_CompactDom *dom, size_t length,
+                      xml_Document *doc) {
+    *doc = (xml_Document){
+        .src = dom->src,
+        .length = length,
+        .lazy = true,
+        .compact = dom,
+    };
+
+    // Atoms keep the numbers they had in the document the DOM was built from.
+    xml_AtomTable *atoms = &doc->atoms;
+    atoms->count = dom->atom_count;
+    atoms->capacity = dom->atom_count;
+    atoms->names = mem_malloc(atoms->capacity * sizeof(*atoms->names));
+    atoms->names[XML_ATOM_NONE] = (StringView){ 0 };
+    for (xml_Atom atom = 1; atom < atoms->count; atom++) {
+        atoms->names[atom] = (StringView){
+            .start = &dom->src[dom->atom_offsets[atom]],
+            .length = dom->atom_lengths[atom],
+        };
+    }
+    while (2 * atoms->count >= atoms->slot_count) {
+        grow_atom_slots(atoms);
+    }
+
+    load_compact_node(doc, 0, &doc->root);
+    return true;
+}
+
+bool xml_expand(xml_Document *doc, xml_Token *token) {
+    if (token->type != XML_TOKEN_NODE ||
+        token->value.content.unparsed == NULL) {
+        return true;
+    }
+
+    if (doc->compact != NULL) {
+        expand_compact(doc, &token->value.content);
+        return true;
+    }
+
+    xml_ContentList *content_list = &token->value.content;
+    ParseContext ctx = {
+        .src = doc->src,
+        .length = doc->length,
+        .cursor = (size_t)(content_list->unparsed - doc->src),
+        .arena = &doc->arena,
+        .atoms = &doc->atoms,
+        .lazy = doc->lazy,
+        .token_stack = {
+            .tokens = doc->scratch_tokens,
+            .capacity = doc->scratch_tokens_capacity,
+        },
+        .attrib_stack = {
+            .attribs = doc->scratch_attribs,
+            .capacity = doc->scratch_attribs_capacity,
+        },
+    };
+
+    bool success = false;
     if (setjmp(ctx.on_error)) {
         fprintf(stderr, "XML error: parsing failed!\n");
-        return false;
     } else {
-        skip_whitespace(&ctx);
-        *token = parse_xml(&ctx);
+        parse_children(&ctx, content_list);
+        content_list->unparsed = NULL;
+        success = true;
+    }
+
+    doc->scratch_tokens = ctx.token_stack.tokens;
+    doc->scratch_tokens_capacity = ctx.token_stack.capacity;
+    doc->scratch_attribs = ctx.attrib_stack.attribs;
+    doc->scratch_attribs_capacity = ctx.attrib_stack.capacity;
+    return success;
+}
+
+bool xml_expand_all(xml_Document *doc, xml_Token *token) {
+    if (token->type != XML_TOKEN_NODE) {
         return true;
     }
+
+    if (!xml_expand(doc, token)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < token->value.content.length; i++) {
+        if (!xml_expand_all(doc, &token->value.content.tokens[i])) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool xml_get_attribute(xml_Token token, const char *property, StringView *out) {
@@ -337,3 +1566,43 @@ bool xml_get_attribute(xml_Token token, const char *property, StringView *out) {
 
     return false;
 }
+
+xml_Atom xml_atom(xml_Document *doc, const char *name) {
+    StringView sv = { .start = name, .length = convenient_strlen(name) };
+
+    if (doc->atoms.slot_count > 0) {
+        xml_Atom atom = doc->atoms.slots[find_atom_slot(&doc->atoms, sv)];
+        if (atom != XML_ATOM_NONE) {
+            return atom;
+        }
+    }
+
+    // Lazily parsed elements intern their names once they are expanded, so
+    // the name has to be given an atom now. The arena keeps a copy alive.
+    char *copy = arena_alloc(&doc->arena, sv.length);
+    memcpy(copy, name, sv.length);
+    sv.start = copy;
+    return intern(&doc->atoms, sv);
+}
+
+StringView xml_atom_name(const xml_Document *doc, xml_Atom atom) {
+    assert(atom != XML_ATOM_NONE && atom < doc->atoms.count);
+    return doc->atoms.names[atom];
+}
+
+bool xml_get_attribute_atom(xml_Token token, xml_Atom property,
+                            StringView *out) {
+    if (token.type != XML_TOKEN_NODE) {
+        fprintf(stderr, "XML_get_attribute: expected a node, got text!\n");
+        return false;
+    }
+    for (size_t i = 0; i < token.value.content.tag.attribs.length; i++) {
+        xml_Attrib attrib = token.value.content.tag.attribs.attribs[i];
+        if (attrib.atom == property) {
+            *out = attrib.value;
+            return true;
+        }
+    }
+
+    return false;
+}
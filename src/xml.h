@@ -1,25 +1,41 @@
 #ifndef XML_H
 #define XML_H
 
+#include "arena.h"
 #include "string_view.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef enum { XML_TOKEN_TEXT, XML_TOKEN_NODE } xml_TokenType;
 
+// Tag and attribute names are interned while parsing. Two names are equal if
+// and only if their atoms are equal. Atom 0 is never handed out.
+typedef uint32_t xml_Atom;
+#define XML_ATOM_NONE 0
+
+typedef struct {
+    StringView *names;
+    size_t count;
+    size_t capacity;
+    xml_Atom *slots;
+    size_t slot_count;
+} xml_AtomTable;
+
 typedef struct {
     StringView name;
     StringView value;
+    xml_Atom atom;
 } xml_Attrib;
 
 typedef struct {
     xml_Attrib *attribs;
     size_t length;
-    size_t capacity;
 } xml_Attribs;
 
 typedef struct {
     StringView name;
+    xml_Atom atom;
     xml_Attribs attribs;
 } xml_Tag;
 
@@ -27,7 +43,10 @@ typedef struct {
     xml_Tag tag;
     struct _xml_Token *tokens;
     size_t length;
-    size_t capacity;
+    // Set while the content of a lazily parsed element hasn't been parsed yet.
+    // Points just past the element's start tag, or at the tag name in
+    // documents loaded from a compact DOM.
+    const char *unparsed;
 } xml_ContentList;
 
 typedef struct _xml_Token {
@@ -38,10 +57,137 @@ typedef struct _xml_Token {
     } value;
 } xml_Token;
 
-bool xml_parse_file(const char *src, xml_Token *token);
-void xml_free(xml_Token root);
+// A parsed document. Every token and attribute array is owned by `arena`, so
+// the whole tree is released at once by `xml_free`.
+typedef struct {
+    xml_Token root;
+    Arena arena;
+    xml_AtomTable atoms;
+
+    const char *src;
+    size_t length;
+    bool lazy;
+    // Set for documents loaded from a compact DOM, which they expand from
+    // instead of parsing `src`.
+    const struct _xml_CompactDom *compact;
+
+    // Scratch space kept between calls to `xml_expand`.
+    xml_Token *scratch_tokens;
+    size_t scratch_tokens_capacity;
+    xml_Attrib *scratch_attribs;
+    size_t scratch_attribs_capacity;
+} xml_Document;
+
+typedef struct {
+    // Only parse the tag and attributes of each element. Its content is
+    // skipped and parsed, one level at a time, by `xml_expand`.
+    bool lazy;
+    // Parse the top-level sections of the document on this many threads.
+    // Values below 2 parse serially. Ignored when `lazy` is set.
+    size_t threads;
+} xml_ParseOptions;
+
+// `src` doesn't need to be NUL-terminated. Every string view in the document
+// points into it, so it must outlive the document.
+bool xml_parse_file(const char *src, size_t length, xml_ParseOptions options,
+                    xml_Document *doc);
+void xml_free(xml_Document *doc);
+
+// Loads a document from a compact DOM without parsing anything. Elements are
+// expanded on demand, as in a lazily parsed document, by indexing into `dom`,
+// which must outlive the document.
+bool xml_load_compact(const struct _xml_CompactDom *dom, size_t length,
+                      xml_Document *doc);
+
+// Parses the children of a lazily parsed element in place. Does nothing if
+// they are already available.
+bool xml_expand(xml_Document *doc, xml_Token *token);
+bool xml_expand_all(xml_Document *doc, xml_Token *token);
+
+// Returns the atom of a tag or attribute name, interning it if the document
+// hasn't seen it yet.
+xml_Atom xml_atom(xml_Document *doc, const char *name);
+StringView xml_atom_name(const xml_Document *doc, xml_Atom atom);
 
 bool xml_get_attribute(xml_Token token, const char *property, StringView *out);
+bool xml_get_attribute_atom(xml_Token token, xml_Atom property,
+                            StringView *out);
+
+// Event-driven parsing. Input is fed in chunks of any size and callbacks fire
+// as soon as a complete tag or text run is available, so memory use is bounded
+// by the nesting depth and the longest tag rather than by the document size.
+// An element produces `start_element`, one `attribute` per attribute,
+// then its content and finally `end_element`. Text may be reported in several
+// consecutive pieces. Names and values are only valid during the callback and,
+// like the DOM, entities are not decoded.
+typedef struct {
+    void *user;
+    void (*start_element)(void *user, StringView name);
+    void (*attribute)(void *user, StringView name, StringView value);
+    void (*text)(void *user, StringView text);
+    void (*end_element)(void *user, StringView name);
+} xml_SaxHandler;
+
+typedef struct {
+    xml_SaxHandler handler;
+
+    // Input that has been fed but not consumed yet.
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    size_t cursor;
+
+    // Names of the currently open elements, stored back to back.
+    char *open_names;
+    size_t open_names_length;
+    size_t open_names_capacity;
+    size_t *open_offsets;
+    size_t depth;
+    size_t open_offsets_capacity;
+
+    bool seen_root;
+    bool failed;
+} xml_SaxParser;
+
+void xml_sax_init(xml_SaxParser *parser, xml_SaxHandler handler);
+bool xml_sax_feed(xml_SaxParser *parser, const char *chunk, size_t length);
+bool xml_sax_finish(xml_SaxParser *parser);
+void xml_sax_free(xml_SaxParser *parser);
+
+// Feeds the whole of `file`, which may be a pipe, through a SAX parser.
+bool xml_sax_parse_stream(FILE *file, xml_SaxHandler handler);
+
+// How `xml_write_document` writes an element.
+typedef enum {
+    // Leave the element out, along with the text right before it.
+    XML_WRITE_SKIP,
+    // Write the element with all of its content.
+    XML_WRITE_ALL,
+    // Write the element's tag only, as an empty element.
+    XML_WRITE_TAG,
+    // Write the element and ask the filter about each of its children.
+    XML_WRITE_FILTER,
+} xml_WriteMode;
+
+typedef xml_WriteMode (*xml_WriteFilter)(void *user, const xml_Token *element);
+
+// Writes the document back out as XML, starting with the root. Names, text and
+// attribute values are copied verbatim from the source, so entities and
+// attribute order survive a round trip. Comments are dropped. Lazily parsed
+// elements are expanded on the way. A NULL `filter` writes everything.
+bool xml_write_document(xml_Document *doc, xml_WriteFilter filter, void *user,
+                        FILE *file);
+
+// The contents of an input file. Regular files are memory-mapped and parsed in
+// place; anything else is read into memory. `data` isn't NUL-terminated.
+typedef struct {
+    const char *data;
+    size_t length;
+    bool mapped;
+} xml_Input;
+
+bool xml_open_input(const char *file_name, xml_Input *input);
+void xml_close_input(xml_Input *input);
 
 char *xml_read_file(const char *file_name);
 void xml_debug_print(FILE *file, xml_Token root);
@@ -0,0 +1,354 @@
+// Benchmarks `xml_parse_file` and `xml_free` on the GL registry and on
+// synthetic registry-shaped documents of increasing size. Every run prints one
+// JSON object per line, so results can be collected and compared across
+// commits.
+
+#include "stats.h"
+#include "string_buffer.h"
+#include "xml.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef CLAD_GL_XML
+#define CLAD_GL_XML "files/gl.xml"
+#endif
+
+#define MAX_SCALES 16
+
+typedef struct {
+    const char *xml_path;
+    const char *label;
+    size_t iterations;
+    // Synthetic corpora are multiples of this, or of the registry if 0.
+    size_t base_kib;
+    size_t scales[MAX_SCALES];
+    size_t scale_count;
+    bool lazy;
+    size_t threads;
+    // The size of the registry, which every corpus is also reported against.
+    size_t registry_bytes;
+} BenchOptions;
+
+typedef struct {
+    size_t nodes;
+    size_t attributes;
+} TreeStats;
+
+static void count_tree(xml_Token token, TreeStats *stats) {
+    stats->nodes++;
+    if (token.type == XML_TOKEN_TEXT) {
+        return;
+    }
+
+    stats->attributes += token.value.content.tag.attribs.length;
+    for (size_t i = 0; i < token.value.content.length; i++) {
+        count_tree(token.value.content.tokens[i], stats);
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static double median(double *values, size_t count) {
+    qsort(values, count, sizeof(*values), compare_doubles);
+    return count % 2 ? values[count / 2]
+                     : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Appends synthetic sections to `sb` until it has grown by `target` bytes. The
+// sections mimic gl.xml: blocks of <enum>s, <command>s with protos and params,
+// <feature>s and <extension>s that require them, with comments and entities.
+static void put_enums(StringBuffer *sb, size_t target, size_t *counter) {
+    size_t end = sb->length + target;
+    while (sb->length < end) {
+        size_t block = (*counter)++;
+        sb_printf(sb,
+                  "    <enums namespace=\"GL\" start=\"0x%zX\" end=\"0x%zX\" "
+                  "vendor=\"SYNTH\" comment=\"Synthetic block %zu\">\n",
+                  block * 16, block * 16 + 15, block);
+        for (size_t i = 0; i < 16; i++) {
+            sb_printf(sb,
+                      "        <enum value=\"0x%zX\" name=\"GL_SYNTH_%zu\" "
+                      "group=\"SynthGroup%zu\"/>\n",
+                      block * 16 + i, block * 16 + i, block % 64);
+        }
+        sb_puts("    </enums>\n", sb);
+    }
+}
+
+static void put_commands(StringBuffer *sb, size_t target, size_t *counter) {
+    size_t end = sb->length + target;
+    sb_puts("    <commands namespace=\"GL\">\n", sb);
+    while (sb->length < end) {
+        size_t command = (*counter)++;
+        sb_printf(sb,
+                  "        <command>\n"
+                  "            <proto>void <name>glSynth%zu</name></proto>\n"
+                  "            <param group=\"SynthGroup%zu\"><ptype>GLenum"
+                  "</ptype> <name>target</name></param>\n"
+                  "            <param len=\"count\">const <ptype>GLfloat"
+                  "</ptype> *<name>values</name></param>\n"
+                  "            <glx type=\"render\" opcode=\"%zu\"/>\n"
+                  "        </command>\n",
+                  command, command % 64, command);
+    }
+    sb_puts("    </commands>\n", sb);
+}
+
+static void put_features(StringBuffer *sb, size_t target, size_t *counter) {
+    size_t end = sb->length + target;
+    while (sb->length < end) {
+        size_t feature = (*counter)++;
+        sb_printf(sb,
+                  "    <feature api=\"gl\" name=\"GL_VERSION_SYNTH_%zu\" "
+                  "number=\"%zu.0\">\n"
+                  "        <!-- Synthetic feature -->\n"
+                  "        <require comment=\"Synthetic &lt;%zu&gt;\">\n",
+                  feature, feature, feature);
+        for (size_t i = 0; i < 8; i++) {
+            sb_printf(sb,
+                      "            <enum name=\"GL_SYNTH_%zu\"/>\n"
+                      "            <command name=\"glSynth%zu\"/>\n",
+                      feature * 8 + i, feature * 8 + i);
+        }
+        sb_puts("        </require>\n    </feature>\n", sb);
+    }
+}
+
+static void put_extensions(StringBuffer *sb, size_t target, size_t *counter) {
+    size_t end = sb->length + target;
+    sb_puts("    <extensions>\n", sb);
+    while (sb->length < end) {
+        size_t extension = (*counter)++;
+        sb_printf(sb,
+                  "        <extension name=\"GL_SYNTH_extension_%zu\" "
+                  "supported=\"gl|glcore\">\n"
+                  "            <require>\n"
+                  "                <enum name=\"GL_SYNTH_%zu\"/>\n"
+                  "                <enum name=\"GL_SYNTH_%zu\"/>\n"
+                  "                <command name=\"glSynth%zu\"/>\n"
+                  "            </require>\n"
+                  "        </extension>\n",
+                  extension, 2 * extension, 2 * extension + 1, extension);
+    }
+    sb_puts("    </extensions>\n", sb);
+}
+
+// Builds a registry of roughly `size` bytes, split between sections in about
+// the proportions of gl.xml.
+static StringBuffer generate_registry(size_t size) {
+    StringBuffer sb = sb_new_buffer();
+    size_t enums = 0, commands = 0, features = 0, extensions = 0;
+
+    sb_puts("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<registry>\n"
+            "    <comment>Synthetic registry for clad_xml_bench</comment>\n"
+            "    <types>\n"
+            "        <type name=\"khrplatform\">#include "
+            "&lt;KHR/khrplatform.h&gt;</type>\n"
+            "        <type>typedef unsigned int <name>GLenum</name>;</type>\n"
+            "        <type>typedef float <name>GLfloat</name>;</type>\n"
+            "    </types>\n",
+            &sb);
+    put_enums(&sb, size / 5, &enums);
+    put_commands(&sb, size * 12 / 25, &commands);
+    put_features(&sb, size / 10, &features);
+    put_extensions(&sb, size / 5, &extensions);
+    sb_puts("</registry>\n", &sb);
+
+    return sb;
+}
+
+// Labels are written as JSON strings, so quotes and backslashes are escaped.
+static void print_json_string(const char *str) {
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            putchar('\\');
+        }
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+static void run_bench(const BenchOptions *options, const char *corpus,
+                      size_t scale, const char *src, size_t length) {
+    // Big documents get fewer iterations, so that every scale takes about as
+    // long as the registry itself.
+    size_t iterations = options->iterations;
+    if (scale > 1) {
+        iterations = options->iterations / scale;
+        if (iterations < 3) {
+            iterations = 3;
+        }
+    }
+
+    double *parse_times = malloc(iterations * sizeof(*parse_times));
+    double *free_times = malloc(iterations * sizeof(*free_times));
+    xml_ParseOptions parse_options = {
+        .lazy = options->lazy,
+        .threads = options->threads,
+    };
+
+    TreeStats stats = { 0 };
+    size_t arena_blocks = 0;
+    size_t arena_bytes = 0;
+    // What the first parse allocated, counted through the mem.h hooks.
+    Stats before = { 0 };
+    Stats after = { 0 };
+
+    for (size_t i = 0; i < iterations; i++) {
+        xml_Document doc;
+        if (i == 0) {
+            stats_finish(&before);
+        }
+        double start = stats_now();
+        if (!xml_parse_file(src, length, parse_options, &doc)) {
+            fprintf(stderr, "error: failed to parse the %s corpus!\n", corpus);
+            exit(EXIT_FAILURE);
+        }
+        double parsed = stats_now();
+
+        if (i == 0) {
+            stats_finish(&after);
+            count_tree(doc.root, &stats);
+            arena_blocks = doc.arena.block_count;
+            arena_bytes = doc.arena.bytes_used;
+        }
+
+        double freeing = stats_now();
+        xml_free(&doc);
+        double freed = stats_now();
+
+        parse_times[i] = parsed - start;
+        free_times[i] = freed - freeing;
+    }
+
+    double parse_median = median(parse_times, iterations);
+    double free_median = median(free_times, iterations);
+    Stats end = { 0 };
+    stats_finish(&end);
+
+    // `median` sorts the times, so the first one is the fastest.
+    printf("{\"bench\":\"xml_parse\",\"label\":");
+    print_json_string(options->label);
+    printf(",\"corpus\":\"%s\",\"scale\":%zu,\"bytes\":%zu,"
+           "\"gl_xml_multiple\":%.2f,"
+           "\"iterations\":%zu,\"lazy\":%s,\"threads\":%zu,"
+           "\"nodes\":%zu,\"attributes\":%zu,"
+           "\"parse_ms_min\":%.3f,\"parse_ms_median\":%.3f,"
+           "\"free_ms_median\":%.3f,\"mb_per_s\":%.1f,\"nodes_per_s\":%.0f,"
+           "\"allocations\":%llu,\"allocated_bytes\":%llu,"
+           "\"arena_blocks\":%zu,\"arena_bytes\":%zu,\"peak_rss_kib\":%llu}\n",
+           corpus, scale, length,
+           (double)length / (double)options->registry_bytes, iterations,
+           options->lazy ? "true" : "false", options->threads, stats.nodes,
+           stats.attributes, parse_times[0] * 1e3, parse_median * 1e3,
+           free_median * 1e3, (double)length / 1e6 / parse_median,
+           (double)stats.nodes / parse_median,
+           (unsigned long long)(after.allocations - before.allocations),
+           (unsigned long long)(after.allocated_bytes -
+                                before.allocated_bytes),
+           arena_blocks, arena_bytes,
+           (unsigned long long)end.peak_rss_bytes / 1024);
+    fflush(stdout);
+
+    free(parse_times);
+    free(free_times);
+}
+
+static bool parse_scales(const char *list, BenchOptions *options) {
+    options->scale_count = 0;
+    while (*list != '\0') {
+        char *end;
+        unsigned long scale = strtoul(list, &end, 10);
+        if (end == list || scale == 0 || options->scale_count >= MAX_SCALES) {
+            return false;
+        }
+        options->scales[options->scale_count++] = scale;
+        list = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+static void print_usage(void) {
+    fprintf(stderr,
+            "Usage: clad_xml_bench [--xml <path>] [--iterations <n>]\n"
+            "                      [--scales <n,n,...>] [--base-kib <n>]\n"
+            "                      [--lazy] [--threads <n>] [--label <text>]\n"
+            "\n"
+            "Synthetic corpora are `scale` times the registry, or times\n"
+            "`base-kib` KiB if given. The default scales are 10 and 100; the\n"
+            "100x corpus is about 270 MB of XML and peaks at about 1.7 GB of\n"
+            "memory. Memory grows linearly, so `--scales 10,100,1000` needs\n"
+            "about 17 GB.\n");
+}
+
+static bool parse_options(char **argv, BenchOptions *options) {
+    for (char **arg = argv + 1; *arg != NULL; arg++) {
+        bool has_value = arg[1] != NULL;
+        if (strcmp(*arg, "--lazy") == 0) {
+            options->lazy = true;
+        } else if (strcmp(*arg, "--xml") == 0 && has_value) {
+            options->xml_path = *++arg;
+        } else if (strcmp(*arg, "--label") == 0 && has_value) {
+            options->label = *++arg;
+        } else if (strcmp(*arg, "--iterations") == 0 && has_value) {
+            options->iterations = strtoul(*++arg, NULL, 10);
+        } else if (strcmp(*arg, "--base-kib") == 0 && has_value) {
+            options->base_kib = strtoul(*++arg, NULL, 10);
+        } else if (strcmp(*arg, "--threads") == 0 && has_value) {
+            options->threads = strtoul(*++arg, NULL, 10);
+        } else if (strcmp(*arg, "--scales") == 0 && has_value) {
+            if (!parse_scales(*++arg, options)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return options->iterations > 0;
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+
+    BenchOptions options = {
+        .xml_path = CLAD_GL_XML,
+        .label = "",
+        .iterations = 20,
+        .scales = { 10, 100 },
+        .scale_count = 2,
+        .threads = 1,
+    };
+    if (!parse_options(argv, &options)) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    stats_count_allocations();
+
+    xml_Input input;
+    if (!xml_open_input(options.xml_path, &input)) {
+        return EXIT_FAILURE;
+    }
+    options.registry_bytes = input.length;
+    run_bench(&options, "registry", 1, input.data, input.length);
+    xml_close_input(&input);
+
+    size_t base_bytes =
+        options.base_kib ? options.base_kib * 1024 : options.registry_bytes;
+    for (size_t i = 0; i < options.scale_count; i++) {
+        size_t scale = options.scales[i];
+        StringBuffer registry = generate_registry(scale * base_bytes);
+        run_bench(&options, "synthetic", scale, registry.ptr,
+                  registry.length);
+        sb_free(registry);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,315 @@
+#include "xml_compact.h"
+#include "mem.h"
+#include <stdio.h>
+#include <string.h>
+
+#define IMAGE_MAGIC "CLADXML"
+#define IMAGE_VERSION 1
+
+// Saved images are this header followed by the DOM's allocation, verbatim.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t attrib_count;
+    uint32_t atom_count;
+    uint64_t length;
+    uint64_t key;
+} ImageHeader;
+
+typedef struct {
+    xml_CompactDom *dom;
+    uint32_t node;
+    uint32_t attrib;
+} BuildContext;
+
+static void count_recursively(xml_Token token, size_t *nodes, size_t *attribs,
+                              size_t *atoms) {
+    (*nodes)++;
+    if (token.type == XML_TOKEN_TEXT) {
+        return;
+    }
+
+    xml_Tag tag = token.value.content.tag;
+    *attribs += tag.attribs.length;
+    if (tag.atom >= *atoms) {
+        *atoms = tag.atom + 1;
+    }
+    for (size_t i = 0; i < tag.attribs.length; i++) {
+        if (tag.attribs.attribs[i].atom >= *atoms) {
+            *atoms = tag.attribs.attribs[i].atom + 1;
+        }
+    }
+
+    for (size_t i = 0; i < token.value.content.length; i++) {
+        count_recursively(token.value.content.tokens[i], nodes, attribs,
+                          atoms);
+    }
+}
+
+static void put_span(const char *src, StringView sv, uint32_t *offset,
+                     uint32_t *length) {
+    *offset = (uint32_t)(sv.start - src);
+    *length = (uint32_t)sv.length;
+}
+
+static uint32_t build_recursively(BuildContext *ctx, xml_Token token) {
+    xml_CompactDom *dom = ctx->dom;
+    uint32_t node = ctx->node++;
+
+    dom->types[node] = token.type;
+    dom->first_child[node] = XML_COMPACT_NONE;
+    dom->next_sibling[node] = XML_COMPACT_NONE;
+    dom->first_attrib[node] = ctx->attrib;
+    dom->atoms[node] = XML_ATOM_NONE;
+
+    if (token.type == XML_TOKEN_TEXT) {
+        put_span(dom->src, token.value.text, &dom->offsets[node],
+                 &dom->lengths[node]);
+        return node;
+    }
+
+    xml_ContentList content = token.value.content;
+    put_span(dom->src, content.tag.name, &dom->offsets[node],
+             &dom->lengths[node]);
+    dom->atoms[node] = content.tag.atom;
+    // Atoms are named after the first node that uses them.
+    if (dom->atom_lengths[content.tag.atom] == 0) {
+        put_span(dom->src, content.tag.name,
+                 &dom->atom_offsets[content.tag.atom],
+                 &dom->atom_lengths[content.tag.atom]);
+    }
+
+    for (size_t i = 0; i < content.tag.attribs.length; i++) {
+        xml_Attrib attrib = content.tag.attribs.attribs[i];
+        uint32_t index = ctx->attrib++;
+        put_span(dom->src, attrib.name, &dom->attrib_name_offsets[index],
+                 &dom->attrib_name_lengths[index]);
+        put_span(dom->src, attrib.value, &dom->attrib_value_offsets[index],
+                 &dom->attrib_value_lengths[index]);
+        dom->attrib_atoms[index] = attrib.atom;
+        if (dom->atom_lengths[attrib.atom] == 0) {
+            put_span(dom->src, attrib.name, &dom->atom_offsets[attrib.atom],
+                     &dom->atom_lengths[attrib.atom]);
+        }
+    }
+
+    uint32_t previous = XML_COMPACT_NONE;
+    for (size_t i = 0; i < content.length; i++) {
+        uint32_t child = build_recursively(ctx, content.tokens[i]);
+        if (previous == XML_COMPACT_NONE) {
+            dom->first_child[node] = child;
+        } else {
+            dom->next_sibling[previous] = child;
+        }
+        previous = child;
+    }
+
+    return node;
+}
+
+static size_t block_size(size_t node_count, size_t attrib_count,
+                         size_t atom_count) {
+    return (6 * node_count + 1 + 5 * attrib_count + 2 * atom_count) *
+               sizeof(uint32_t) +
+           node_count;
+}
+
+// Carves the arrays of the DOM out of a single block. The 32-bit arrays come
+// first so that every one of them stays aligned.
+static void lay_out(xml_CompactDom *dom, uint32_t *block) {
+    size_t node_count = dom->node_count;
+    size_t attrib_count = dom->attrib_count;
+    size_t atom_count = dom->atom_count;
+
+    dom->offsets = block;
+    dom->lengths = dom->offsets + node_count;
+    dom->first_child = dom->lengths + node_count;
+    dom->next_sibling = dom->first_child + node_count;
+    dom->first_attrib = dom->next_sibling + node_count;
+    dom->atoms = dom->first_attrib + node_count + 1;
+    dom->attrib_name_offsets = dom->atoms + node_count;
+    dom->attrib_name_lengths = dom->attrib_name_offsets + attrib_count;
+    dom->attrib_value_offsets = dom->attrib_name_lengths + attrib_count;
+    dom->attrib_value_lengths = dom->attrib_value_offsets + attrib_count;
+    dom->attrib_atoms = dom->attrib_value_lengths + attrib_count;
+    dom->atom_offsets = dom->attrib_atoms + attrib_count;
+    dom->atom_lengths = dom->atom_offsets + atom_count;
+    dom->types = (uint8_t *)(dom->atom_lengths + atom_count);
+}
+
+bool xml_compact_build(const char *src, xml_Token root, xml_CompactDom *dom) {
+    *dom = (xml_CompactDom){ 0 };
+
+    size_t node_count = 0;
+    size_t attrib_count = 0;
+    size_t atom_count = 1;
+    count_recursively(root, &node_count, &attrib_count, &atom_count);
+
+    if (node_count >= XML_COMPACT_NONE || attrib_count >= XML_COMPACT_NONE) {
+        fprintf(stderr, "XML error: document too large for a compact DOM!\n");
+        return false;
+    }
+
+    // Zeroed, so that the names of atoms start out empty.
+    uint32_t *block =
+        mem_calloc(1, block_size(node_count, attrib_count, atom_count));
+    if (block == NULL) {
+        return false;
+    }
+
+    dom->src = src;
+    dom->node_count = (uint32_t)node_count;
+    dom->attrib_count = (uint32_t)attrib_count;
+    dom->atom_count = (uint32_t)atom_count;
+    lay_out(dom, block);
+
+    BuildContext ctx = { .dom = dom };
+    build_recursively(&ctx, root);
+    dom->first_attrib[node_count] = ctx.attrib;
+
+    return true;
+}
+
+void xml_compact_free(xml_CompactDom *dom) {
+    mem_free(dom->offsets);
+    *dom = (xml_CompactDom){ 0 };
+}
+
+size_t xml_compact_memory(const xml_CompactDom *dom) {
+    return block_size(dom->node_count, dom->attrib_count, dom->atom_count);
+}
+
+uint64_t xml_compact_hash(const char *src, size_t length) {
+    // FNV-1a over 64-bit words, with a rotation so that every bit of the
+    // input also reaches the low bits of the hash.
+    uint64_t hash = 14695981039346656037ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, &src[i], sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+        hash = (hash << 29) | (hash >> 35);
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ (unsigned char)src[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool xml_compact_save(const xml_CompactDom *dom, size_t length, uint64_t key,
+                      const char *path) {
+    ImageHeader header = {
+        .magic = IMAGE_MAGIC,
+        .version = IMAGE_VERSION,
+        .node_count = dom->node_count,
+        .attrib_count = dom->attrib_count,
+        .atom_count = dom->atom_count,
+        .length = length,
+        .key = key,
+    };
+
+    // Write to a temporary file first, so that a concurrent or interrupted
+    // run never sees half an image.
+    size_t path_length = strlen(path);
+    char *temp_path = mem_malloc(path_length + sizeof(".tmp"));
+    memcpy(temp_path, path, path_length);
+    memcpy(&temp_path[path_length], ".tmp", sizeof(".tmp"));
+
+    FILE *file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "XML error: couldn't write `%s`!\n", temp_path);
+        mem_free(temp_path);
+        return false;
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(dom->offsets, xml_compact_memory(dom), 1, file) == 1;
+    success = fclose(file) == 0 && success;
+
+#ifdef _WIN32
+    // `rename` doesn't replace existing files on Windows.
+    remove(path);
+#endif
+    success = success && rename(temp_path, path) == 0;
+    if (!success) {
+        fprintf(stderr, "XML error: couldn't write `%s`!\n", path);
+        remove(temp_path);
+    }
+
+    mem_free(temp_path);
+    return success;
+}
+
+bool xml_compact_view(const char *src, size_t length, uint64_t key,
+                      const void *image, size_t image_size,
+                      xml_CompactDom *dom) {
+    *dom = (xml_CompactDom){ 0 };
+
+    ImageHeader header;
+    if (image_size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, image, sizeof(header));
+
+    if (memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 ||
+        header.version != IMAGE_VERSION || header.length != length ||
+        header.key != key || header.node_count == 0 ||
+        image_size - sizeof(header) !=
+            block_size(header.node_count, header.attrib_count,
+                       header.atom_count)) {
+        return false;
+    }
+
+    dom->src = src;
+    dom->node_count = header.node_count;
+    dom->attrib_count = header.attrib_count;
+    dom->atom_count = header.atom_count;
+    lay_out(dom, (uint32_t *)((const char *)image + sizeof(header)));
+    return true;
+}
+
+StringView xml_compact_name(const xml_CompactDom *dom, uint32_t node) {
+    return (StringView){
+        .start = &dom->src[dom->offsets[node]],
+        .length = dom->lengths[node],
+    };
+}
+
+uint32_t xml_compact_find_next(const xml_CompactDom *dom, uint32_t node,
+                               const char *tag) {
+    while (node != XML_COMPACT_NONE) {
+        if (dom->types[node] == XML_TOKEN_NODE &&
+            sv_equal_cstr(xml_compact_name(dom, node), tag)) {
+            return node;
+        }
+        node = dom->next_sibling[node];
+    }
+    return XML_COMPACT_NONE;
+}
+
+bool xml_compact_get_attribute(const xml_CompactDom *dom, uint32_t node,
+                               const char *property, StringView *out) {
+    if (dom->types[node] != XML_TOKEN_NODE) {
+        fprintf(stderr, "XML_get_attribute: expected a node, got text!\n");
+        return false;
+    }
+
+    for (uint32_t i = dom->first_attrib[node]; i < dom->first_attrib[node + 1];
+         i++) {
+        StringView name = {
+            .start = &dom->src[dom->attrib_name_offsets[i]],
+            .length = dom->attrib_name_lengths[i],
+        };
+
+        if (sv_equal_cstr(name, property)) {
+            *out = (StringView){
+                .start = &dom->src[dom->attrib_value_offsets[i]],
+                .length = dom->attrib_value_lengths[i],
+            };
+            return true;
+        }
+    }
+
+    return false;
+}
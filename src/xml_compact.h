@@ -0,0 +1,72 @@
+#ifndef XML_COMPACT_H
+#define XML_COMPACT_H
+
+#include "string_view.h"
+#include "xml.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define XML_COMPACT_NONE UINT32_MAX
+
+// A read-only, flattened copy of a parsed document. Nodes are stored
+// contiguously in document order as a struct of arrays, so node 0 is the root
+// and the children of a node are reached through `first_child` and
+// `next_sibling`. Names, text and attribute values are 32-bit spans into the
+// source buffer the document was parsed from.
+typedef struct _xml_CompactDom {
+    const char *src;
+
+    uint32_t node_count;
+    uint8_t *types;
+    uint32_t *offsets;
+    uint32_t *lengths;
+    uint32_t *first_child;
+    uint32_t *next_sibling;
+    // The attributes of node `i` are `first_attrib[i]..first_attrib[i + 1]`.
+    uint32_t *first_attrib;
+    // `XML_ATOM_NONE` for text nodes.
+    uint32_t *atoms;
+
+    uint32_t attrib_count;
+    uint32_t *attrib_name_offsets;
+    uint32_t *attrib_name_lengths;
+    uint32_t *attrib_value_offsets;
+    uint32_t *attrib_value_lengths;
+    uint32_t *attrib_atoms;
+
+    // The name of every atom used in the document, indexed by atom.
+    uint32_t atom_count;
+    uint32_t *atom_offsets;
+    uint32_t *atom_lengths;
+} xml_CompactDom;
+
+bool xml_compact_build(const char *src, xml_Token root, xml_CompactDom *dom);
+// Don't call this on a DOM that views an image.
+void xml_compact_free(xml_CompactDom *dom);
+size_t xml_compact_memory(const xml_CompactDom *dom);
+
+// A 64-bit hash of the source text, used to key saved images.
+uint64_t xml_compact_hash(const char *src, size_t length);
+
+// Saves the DOM as a binary image that `xml_compact_view` can use in place.
+// The file is replaced atomically. Images use the byte order of the machine
+// that wrote them and are meant as a local cache only.
+bool xml_compact_save(const xml_CompactDom *dom, size_t length, uint64_t key,
+                      const char *path);
+// Points `dom` into a saved image, without copying it. Fails if the image
+// wasn't saved from a source of `length` bytes hashing to `key`. Both the
+// image and `src` must outlive the DOM.
+bool xml_compact_view(const char *src, size_t length, uint64_t key,
+                      const void *image, size_t image_size,
+                      xml_CompactDom *dom);
+
+// The tag name of an element, or the contents of a text node.
+StringView xml_compact_name(const xml_CompactDom *dom, uint32_t node);
+// Returns the first element named `tag` among `node` and its following
+// siblings, or `XML_COMPACT_NONE`.
+uint32_t xml_compact_find_next(const xml_CompactDom *dom, uint32_t node,
+                               const char *tag);
+bool xml_compact_get_attribute(const xml_CompactDom *dom, uint32_t node,
+                               const char *property, StringView *out);
+
+#endif